@@ -39,6 +39,10 @@ class BuildExtension(build_ext):
             flags = os.environ['CMAKE_CXX_FLAGS']
             cmake_args += [f"-DCMAKE_CXX_FLAGS={flags}"]
 
+        # BUILD_LEAN_CLI=1 builds the executables without libtorch
+        if os.environ.get('BUILD_LEAN_CLI', '0') == '1':
+            cmake_args += ["-DBUILD_LEAN_CLI=ON"]
+
         # Set CMAKE_BUILD_PARALLEL_LEVEL to control the parallel build level
         # across all generators.
         if "CMAKE_BUILD_PARALLEL_LEVEL" not in os.environ:
@@ -91,7 +95,12 @@ def _main():
         packages=setuptools.find_packages(where='src'),
         package_dir={'': 'src'},
         data_files=[
-            ('src/tkaldi/bin', ['compute-kaldi-pitch-feats']),
+            ('src/tkaldi/bin', [
+                'compute-kaldi-pitch-feats',
+                'compute-kaldi-pitch-feats-parallel',
+                'compute-cmvn-stats',
+                'apply-cmvn',
+            ]),
         ],
         install_requires=[
             'torch >= 1.7',
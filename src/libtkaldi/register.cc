@@ -1,22 +1,151 @@
+#include <cmath>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <torch/script.h>
 #include "base/kaldi-types.h"
 #include "feat/resample.h"
+#include "feat/resample-banded.h"
 #include "feat/pitch-functions.h"
+#include "feat/pitch-batch.h"
+#include "feat/pitch-cache.h"
+#include "feat/pitch-postprocess.h"
+#include "feat/wave-reader.h"
+#include "transform/cmvn.h"
+#include "util/kaldi-io.h"
+#include "util/npy-table.h"
+#include "util/task-pool.h"
 
 using BaseFloat = kaldi::BaseFloat;
 using int32 = kaldi::int32;
 
 namespace tkaldi {
 
-  torch::Tensor ResampleWaveform(const torch::Tensor &wave, double orig_freq, double new_freq) {
+  // The ops with a `shared_memory` argument allocate their output in shared
+  // memory when it is true, so that it can be sent to another process (e.g.
+  // from a DataLoader worker) without being copied.
+
+  // The output of an op with `shared_memory`, whose storage was reserved in
+  // shared memory. The reserved size is an upper bound, but if the output
+  // still outgrew it, Resize() moved it to ordinary memory; it is then copied
+  // back, with a warning, as the bound needs fixing.
+  torch::Tensor SharedCopy(const torch::Tensor &tensor) {
+    auto shared = kaldi::internal::AllocateSharedTensor(
+      tensor.sizes(), tensor.options());
+    shared.copy_(tensor);
+    return shared;
+  }
+
+  torch::Tensor SharedOutput(const torch::Tensor &output) {
+    if (kaldi::internal::IsSharedTensor(output))
+      return output;
+    KALDI_WARN << "The output (" << output.numel() << " elements) outgrew the "
+               << "shared memory reserved for it; copying it.";
+    return SharedCopy(output);
+  }
+
+  // The samples ([channels, samples]) and the sample frequency of the wave
+  // file `rxfilename`, which can be anything Kaldi's Input accepts (e.g. a
+  // command ending with "|").
+  std::tuple<torch::Tensor, double> ReadWave(const std::string &rxfilename) {
+    kaldi::Input ki(rxfilename);
+    kaldi::WaveData wave;
+    wave.Read(ki.Stream());
+    return std::make_tuple(wave.Data().tensor_,
+                           static_cast<double>(wave.SampFreq()));
+  }
+
+  // The matrix of the .npy file `filename`, mapped copy-on-write (float32)
+  // or converted (float64).
+  torch::Tensor ReadNpy(const std::string &filename) {
+    kaldi::Matrix<BaseFloat> value;
+    kaldi::ReadNpy(filename, &value);
+    return value.tensor_;
+  }
+
+  void WriteNpy(const std::string &filename, const torch::Tensor &matrix) {
+    TORCH_CHECK(matrix.dim() == 2 && matrix.scalar_type() == torch::kFloat32,
+                "Expected a float32 matrix.");
+    kaldi::WriteNpy(filename, kaldi::MatrixBase<BaseFloat>(matrix.contiguous()));
+  }
+
+  std::tuple<std::string, bool> ParseNpySpecifier(const std::string &specifier) {
+    std::string filename;
+    bool is_npz;
+    TORCH_CHECK(kaldi::ClassifyNpySpecifier(specifier, &filename, &is_npz),
+                "Expected npz:<file> or npy:<file>, got ", specifier);
+    return std::make_tuple(filename, is_npz);
+  }
+
+  // The matrices of a .npz archive ("npz:<file>") or of a corpus .npy
+  // ("npy:<file>"), by key.
+  struct NpyArchiveHolder : torch::CustomClassHolder {
+    std::unique_ptr<kaldi::NpyArchiveReader> reader;
+
+    explicit NpyArchiveHolder(const std::string &rspecifier) {
+      auto parsed = ParseNpySpecifier(rspecifier);
+      reader.reset(new kaldi::NpyArchiveReader(std::get<0>(parsed),
+                                               std::get<1>(parsed)));
+    }
+
+    std::vector<std::string> Keys() const {
+      std::vector<std::string> keys;
+      for (int32 i = 0; i < reader->NumEntries(); i++)
+        keys.push_back(reader->Key(i));
+      return keys;
+    }
+
+    bool Contains(const std::string &key) const {
+      return reader->Find(key) >= 0;
+    }
+
+    torch::Tensor Get(const std::string &key) const {
+      const int32 index = reader->Find(key);
+      TORCH_CHECK(index >= 0, "No entry for key ", key);
+      kaldi::Matrix<BaseFloat> value;
+      reader->Value(index, &value);
+      return value.tensor_;
+    }
+
+    int64_t Size() const { return reader->NumEntries(); }
+  };
+
+  struct NpyArchiveWriterHolder : torch::CustomClassHolder {
+    std::unique_ptr<kaldi::NpyArchiveWriter> writer;
+
+    explicit NpyArchiveWriterHolder(const std::string &wspecifier) {
+      auto parsed = ParseNpySpecifier(wspecifier);
+      writer.reset(new kaldi::NpyArchiveWriter(std::get<0>(parsed),
+                                               std::get<1>(parsed)));
+    }
+
+    void Write(const std::string &key, const torch::Tensor &matrix) {
+      TORCH_CHECK(matrix.dim() == 2 && matrix.scalar_type() == torch::kFloat32,
+                  "Expected a float32 matrix.");
+      writer->Write(key, kaldi::MatrixBase<BaseFloat>(matrix.contiguous()));
+    }
+
+    void Close() { writer->Close(); }
+  };
+
+  torch::Tensor ResampleWaveform(
+      const torch::Tensor &wave,
+      double orig_freq,
+      double new_freq,
+      bool shared_memory
+  ) {
+    kaldi::GetResizeStats() = kaldi::ResizeStats();
     kaldi::VectorBase<kaldi::BaseFloat> input(wave);
     kaldi::Vector<kaldi::BaseFloat> output;
+    if (shared_memory)
+      output.ReserveShared(static_cast<int32>(
+        std::ceil(input.Dim() * new_freq / orig_freq)) + 2);
     kaldi::ResampleWaveform(orig_freq, input, new_freq, &output);
-    return output.tensor_;
+    return shared_memory ? SharedOutput(output.tensor_) : output.tensor_;
   }
 
-  torch::Tensor ComputeKaldiPitch(
-      const torch::Tensor &wave,
+  kaldi::PitchExtractionOptions MakePitchOptions(
       double sample_frequency,
       double frame_length,
       double frame_shift,
@@ -38,7 +167,6 @@ namespace tkaldi {
       bool nccf_ballast_online,
       bool snip_edges
   ) {
-    kaldi::VectorBase<kaldi::BaseFloat> input(wave);
     kaldi::PitchExtractionOptions opts;
     opts.samp_freq = static_cast<BaseFloat>(sample_frequency);
     opts.frame_shift_ms = static_cast<BaseFloat>(frame_shift);
@@ -60,14 +188,635 @@ namespace tkaldi {
     opts.recompute_frame = static_cast<int32>(recompute_frame);
     opts.nccf_ballast_online = nccf_ballast_online;
     opts.snip_edges = snip_edges;
+    return opts;
+  }
+
+  // Calls f(view) with a kaldi::StorageMatrix view of `matrix`, which can be
+  // stored as float, float16 or bfloat16.
+  template<typename F>
+  void DispatchStorage(const torch::Tensor &matrix, F f) {
+    TORCH_CHECK(matrix.dim() == 2 &&
+                (matrix.size(1) <= 1 || matrix.stride(1) == 1),
+                "Expected a matrix with contiguous rows.");
+    switch (matrix.scalar_type()) {
+      case torch::kFloat32:
+        f(kaldi::StorageMatrix<float>(matrix));
+        break;
+      case torch::kFloat16:
+        f(kaldi::StorageMatrix<c10::Half>(matrix));
+        break;
+      case torch::kBFloat16:
+        f(kaldi::StorageMatrix<c10::BFloat16>(matrix));
+        break;
+      default:
+        TORCH_CHECK(false, "Unsupported dtype: ", matrix.scalar_type());
+    }
+  }
+
+  torch::Tensor ArbitraryResample(
+      const torch::Tensor &input,
+      double samp_rate_hz,
+      double filter_cutoff_hz,
+      const torch::Tensor &sample_points_secs,
+      int64_t num_zeros,
+      const std::string &method
+  ) {
+    // "reference" and "banded" give the same result; "fused" and "matmul"
+    // match it up to rounding. With "fused", `input` can also be stored as
+    // float16 or bfloat16; it is widened as it is read.
+    TORCH_CHECK(input.dim() == 2, "Expected a matrix.");
+    TORCH_CHECK(method == "reference" || method == "banded" ||
+                method == "fused" || method == "matmul",
+                "Unknown method: ", method,
+                " (expected 'reference', 'banded', 'fused' or 'matmul')");
+    TORCH_CHECK(method == "fused" || input.scalar_type() == torch::kFloat32,
+                "Only the fused method takes reduced precision input.");
+    kaldi::Vector<kaldi::BaseFloat> sample_points(sample_points_secs);
+    const auto samp_rate = static_cast<BaseFloat>(samp_rate_hz);
+    const auto filter_cutoff = static_cast<BaseFloat>(filter_cutoff_hz);
+    if (method == "reference") {
+      kaldi::ArbitraryResample resampler(
+        input.size(1), samp_rate, filter_cutoff, sample_points,
+        static_cast<int32>(num_zeros));
+      kaldi::Matrix<kaldi::BaseFloat> output(
+        input.size(0), resampler.NumSamplesOut(), kaldi::kUndefined);
+      kaldi::MatrixBase<kaldi::BaseFloat> in(input);
+      resampler.Resample(in, &output);
+      return output.tensor_;
+    }
+    kaldi::BandedResample banded(
+      input.size(1), samp_rate, filter_cutoff, sample_points,
+      static_cast<int32>(num_zeros));
+    kaldi::Matrix<kaldi::BaseFloat> output(
+      input.size(0), banded.NumSamplesOut(), kaldi::kUndefined);
+    if (method == "fused") {
+      DispatchStorage(input.contiguous(), [&](const auto &in) {
+        banded.ResampleFused(in, &output);
+      });
+      return output.tensor_;
+    }
+    kaldi::MatrixBase<kaldi::BaseFloat> in(input);
+    if (method == "matmul")
+      banded.ResampleMatMul(in, &output);
+    else
+      banded.Resample(in, &output);
+    return output.tensor_;
+  }
+
+  // An upper bound of the number of frames ComputeKaldiPitch() produces from
+  // `num_samples` samples, regardless of snip_edges.
+  int32 MaxNumPitchFrames(const kaldi::PitchExtractionOptions &opts,
+                          int64_t num_samples) {
+    return static_cast<int32>(
+      (num_samples * opts.resample_freq / opts.samp_freq + 2) /
+      opts.NccfWindowShift() + 2);
+  }
+
+  torch::Tensor ComputeKaldiPitch(
+      const torch::Tensor &wave,
+      double sample_frequency,
+      double frame_length,
+      double frame_shift,
+      double preemphasis_coefficient,
+      double min_f0,
+      double max_f0,
+      double soft_min_f0,
+      double penalty_factor,
+      double lowpass_cutoff,
+      double resample_frequency,
+      double delta_pitch,
+      double nccf_ballast,
+      int64_t lowpass_filter_width,
+      int64_t upsample_filter_width,
+      int64_t max_frames_latency,
+      int64_t frames_per_chunk,
+      bool simulate_first_pass_online,
+      int64_t recompute_frame,
+      bool nccf_ballast_online,
+      bool snip_edges,
+      bool shared_memory
+  ) {
+    kaldi::GetResizeStats() = kaldi::ResizeStats();
+    kaldi::VectorBase<kaldi::BaseFloat> input(wave);
+    kaldi::PitchExtractionOptions opts = MakePitchOptions(
+      sample_frequency, frame_length, frame_shift, preemphasis_coefficient,
+      min_f0, max_f0, soft_min_f0, penalty_factor, lowpass_cutoff,
+      resample_frequency, delta_pitch, nccf_ballast, lowpass_filter_width,
+      upsample_filter_width, max_frames_latency, frames_per_chunk,
+      simulate_first_pass_online, recompute_frame, nccf_ballast_online,
+      snip_edges);
+    kaldi::Matrix<kaldi::BaseFloat> output;
+    if (shared_memory)
+      output.ReserveShared(MaxNumPitchFrames(opts, input.Dim()), 2);
+    kaldi::ComputeKaldiPitch(opts, input, &output);
+    const auto &stats = kaldi::GetResizeStats();
+    KALDI_VLOG(1) << "Resized " << stats.num_resizes << " times, reallocated "
+                  << stats.num_reallocations << " times ("
+                  << stats.bytes_allocated << " bytes) for "
+                  << output.NumRows() << " frames.";
+    return shared_memory ? SharedOutput(output.tensor_) : output.tensor_;
+  }
+
+  struct FeatureCacheHolder : torch::CustomClassHolder {
+    kaldi::FeatureCache cache;
+
+    FeatureCacheHolder(const std::string &dir, int64_t max_bytes)
+      : cache(dir, max_bytes) {}
+
+    c10::Dict<std::string, int64_t> Stats() const {
+      kaldi::FeatureCacheStats stats = cache.Stats();
+      c10::Dict<std::string, int64_t> ret;
+      ret.insert("num_hits", stats.num_hits);
+      ret.insert("num_misses", stats.num_misses);
+      ret.insert("num_evictions", stats.num_evictions);
+      ret.insert("bytes_saved", stats.bytes_saved);
+      ret.insert("bytes_written", stats.bytes_written);
+      return ret;
+    }
+  };
+
+  torch::Tensor ComputeKaldiPitchCached(
+      const torch::Tensor &wave,
+      c10::intrusive_ptr<FeatureCacheHolder> cache,
+      double sample_frequency,
+      double frame_length,
+      double frame_shift,
+      double preemphasis_coefficient,
+      double min_f0,
+      double max_f0,
+      double soft_min_f0,
+      double penalty_factor,
+      double lowpass_cutoff,
+      double resample_frequency,
+      double delta_pitch,
+      double nccf_ballast,
+      int64_t lowpass_filter_width,
+      int64_t upsample_filter_width,
+      int64_t max_frames_latency,
+      int64_t frames_per_chunk,
+      bool simulate_first_pass_online,
+      int64_t recompute_frame,
+      bool nccf_ballast_online,
+      bool snip_edges,
+      bool shared_memory
+  ) {
+    // The key is computed from the samples in memory.
+    kaldi::VectorBase<kaldi::BaseFloat> input(wave.contiguous());
+    kaldi::PitchExtractionOptions opts = MakePitchOptions(
+      sample_frequency, frame_length, frame_shift, preemphasis_coefficient,
+      min_f0, max_f0, soft_min_f0, penalty_factor, lowpass_cutoff,
+      resample_frequency, delta_pitch, nccf_ballast, lowpass_filter_width,
+      upsample_filter_width, max_frames_latency, frames_per_chunk,
+      simulate_first_pass_online, recompute_frame, nccf_ballast_online,
+      snip_edges);
     kaldi::Matrix<kaldi::BaseFloat> output;
+    if (!shared_memory) {
+      kaldi::ComputeKaldiPitchCached(opts, input, &cache->cache, &output);
+      return output.tensor_;
+    }
+    // Same as ComputeKaldiPitchCached(), reserving the shared memory only if
+    // the features are computed. A hit is a mapping of the cache file, which
+    // is copied once into shared memory.
+    const std::string key =
+      kaldi::FeatureCache::Key(input, kaldi::PitchOptionsString(opts));
+    if (cache->cache.Lookup(key, &output))
+      return SharedCopy(output.tensor_);
+    output.ReserveShared(MaxNumPitchFrames(opts, input.Dim()), 2);
     kaldi::ComputeKaldiPitch(opts, input, &output);
+    cache->cache.Insert(key, output);
+    return SharedOutput(output.tensor_);
+  }
+
+  // The scheduler statistics of the last ComputeKaldiPitchBatch call on this thread.
+  thread_local kaldi::SchedulerStats last_batch_stats;
+
+  std::vector<torch::Tensor> ComputeKaldiPitchBatch(
+      const std::vector<torch::Tensor> &waves,
+      double sample_frequency,
+      double frame_length,
+      double frame_shift,
+      double preemphasis_coefficient,
+      double min_f0,
+      double max_f0,
+      double soft_min_f0,
+      double penalty_factor,
+      double lowpass_cutoff,
+      double resample_frequency,
+      double delta_pitch,
+      double nccf_ballast,
+      int64_t lowpass_filter_width,
+      int64_t upsample_filter_width,
+      int64_t max_frames_latency,
+      int64_t frames_per_chunk,
+      bool simulate_first_pass_online,
+      int64_t recompute_frame,
+      bool nccf_ballast_online,
+      bool snip_edges,
+      int64_t num_threads,
+      double max_chunk_length,
+      double chunk_overlap,
+      int64_t intra_op_threads,
+      const std::string &cpu_affinity
+  ) {
+    kaldi::PitchExtractionOptions opts = MakePitchOptions(
+      sample_frequency, frame_length, frame_shift, preemphasis_coefficient,
+      min_f0, max_f0, soft_min_f0, penalty_factor, lowpass_cutoff,
+      resample_frequency, delta_pitch, nccf_ballast, lowpass_filter_width,
+      upsample_filter_width, max_frames_latency, frames_per_chunk,
+      simulate_first_pass_online, recompute_frame, nccf_ballast_online,
+      snip_edges);
+    kaldi::PitchBatchOptions batch_opts;
+    batch_opts.num_threads = static_cast<int32>(num_threads);
+    batch_opts.max_chunk_length = static_cast<BaseFloat>(max_chunk_length);
+    batch_opts.chunk_overlap = static_cast<BaseFloat>(chunk_overlap);
+    batch_opts.execution.intra_op_threads = static_cast<int32>(intra_op_threads);
+    batch_opts.execution.cpu_affinity = cpu_affinity;
+
+    std::vector<kaldi::VectorBase<kaldi::BaseFloat>> inputs;
+    inputs.reserve(waves.size());
+    for (const auto &wave : waves)
+      inputs.emplace_back(wave);
+    std::vector<const kaldi::VectorBase<kaldi::BaseFloat>*> input_ptrs;
+    for (const auto &input : inputs)
+      input_ptrs.push_back(&input);
+
+    std::vector<kaldi::Matrix<kaldi::BaseFloat>> outputs;
+    kaldi::ComputeKaldiPitchBatch(opts, batch_opts, input_ptrs, &outputs,
+                                  NULL, &last_batch_stats);
+    KALDI_VLOG(1) << last_batch_stats.ToString();
+    std::vector<torch::Tensor> ret;
+    for (const auto &output : outputs)
+      ret.push_back(output.tensor_);
+    return ret;
+  }
+
+  // The fraction of the wall time each thread of the last
+  // ComputeKaldiPitchBatch call on this thread spent in tasks.
+  torch::Tensor LastBatchUtilization() {
+    std::vector<double> utilization = last_batch_stats.Utilization();
+    return torch::tensor(utilization, torch::kFloat64);
+  }
+
+  // The workers of the async ops. Each op call is one task.
+  struct AsyncPoolHolder : torch::CustomClassHolder {
+    kaldi::TaskPool pool;
+
+    AsyncPoolHolder(int64_t num_threads, int64_t max_pending)
+      : pool(static_cast<int32>(num_threads), static_cast<int32>(max_pending)) {}
+
+    int64_t NumPending() const { return pool.NumPending(); }
+  };
+
+  // Queues `compute` on the pool, and returns the future it completes with
+  // its result or error. With `block`, waits while the pool is full; without
+  // it, throws instead. The waiting thread keeps the GIL when called from
+  // Python, so other Python threads do not run in the meantime.
+  template<typename Compute>
+  c10::intrusive_ptr<c10::ivalue::Future> RunAsync(AsyncPoolHolder *pool,
+                                                   bool block,
+                                                   Compute compute) {
+    auto future = c10::make_intrusive<c10::ivalue::Future>(c10::TensorType::get());
+    kaldi::TaskPool::Task task = [future, compute]() {
+      try {
+        future->markCompleted(compute());
+      } catch (...) {
+        future->setError(std::current_exception());
+      }
+    };
+    if (block)
+      pool->pool.Submit(std::move(task));
+    else
+      TORCH_CHECK(pool->pool.TrySubmit(std::move(task)),
+                  "The async pool is full.");
+    return future;
+  }
+
+  // Calls `f` with the arguments on the stack, and pushes the future it
+  // returns. The async ops are registered with this boxed kernel, because the
+  // schema of an unboxed one cannot return a Future.
+  template<typename... Args, size_t... I>
+  void CallAsync(c10::intrusive_ptr<c10::ivalue::Future> (*f)(Args...),
+                 torch::jit::Stack *stack, std::index_sequence<I...>) {
+    auto args = torch::jit::last(*stack, sizeof...(Args));
+    auto future = f(args[I].to<typename std::decay<Args>::type>()...);
+    torch::jit::drop(*stack, sizeof...(Args));
+    torch::jit::push(*stack, std::move(future));
+  }
+
+  template<typename... Args>
+  void CallAsync(c10::intrusive_ptr<c10::ivalue::Future> (*f)(Args...),
+                 torch::jit::Stack *stack) {
+    CallAsync(f, stack, std::index_sequence_for<Args...>());
+  }
+
+  template<typename F, F *f>
+  void BoxedAsync(const c10::OperatorHandle &, torch::jit::Stack *stack) {
+    CallAsync(f, stack);
+  }
+
+  // The input tensors are referenced, not copied, until the computation is
+  // done, so they must not be modified in place in the meantime.
+  c10::intrusive_ptr<c10::ivalue::Future> ResampleWaveformAsync(
+      const torch::Tensor &wave,
+      c10::intrusive_ptr<AsyncPoolHolder> pool,
+      bool block,
+      double orig_freq,
+      double new_freq
+  ) {
+    return RunAsync(pool.get(), block, [wave, orig_freq, new_freq]() {
+      return ResampleWaveform(wave, orig_freq, new_freq, false);
+    });
+  }
+
+  c10::intrusive_ptr<c10::ivalue::Future> ComputeKaldiPitchAsync(
+      const torch::Tensor &wave,
+      c10::intrusive_ptr<AsyncPoolHolder> pool,
+      bool block,
+      double sample_frequency,
+      double frame_length,
+      double frame_shift,
+      double preemphasis_coefficient,
+      double min_f0,
+      double max_f0,
+      double soft_min_f0,
+      double penalty_factor,
+      double lowpass_cutoff,
+      double resample_frequency,
+      double delta_pitch,
+      double nccf_ballast,
+      int64_t lowpass_filter_width,
+      int64_t upsample_filter_width,
+      int64_t max_frames_latency,
+      int64_t frames_per_chunk,
+      bool simulate_first_pass_online,
+      int64_t recompute_frame,
+      bool nccf_ballast_online,
+      bool snip_edges
+  ) {
+    return RunAsync(pool.get(), block, [=]() {
+      return ComputeKaldiPitch(
+        wave, sample_frequency, frame_length, frame_shift,
+        preemphasis_coefficient, min_f0, max_f0, soft_min_f0, penalty_factor,
+        lowpass_cutoff, resample_frequency, delta_pitch, nccf_ballast,
+        lowpass_filter_width, upsample_filter_width, max_frames_latency,
+        frames_per_chunk, simulate_first_pass_online, recompute_frame,
+        nccf_ballast_online, snip_edges, false);
+    });
+  }
+
+  torch::Tensor ProcessPitch(
+      const torch::Tensor &input,
+      double pitch_scale,
+      double pov_scale,
+      double pov_offset,
+      double delta_pitch_scale,
+      double delta_pitch_noise_stddev,
+      int64_t normalization_left_context,
+      int64_t normalization_right_context,
+      int64_t delta_window,
+      int64_t delay,
+      bool add_pov_feature,
+      bool add_normalized_log_pitch,
+      bool add_delta_pitch,
+      bool add_raw_log_pitch,
+      const std::string &method
+  ) {
+    kaldi::MatrixBase<kaldi::BaseFloat> feats(input);
+    kaldi::ProcessPitchOptions opts;
+    opts.pitch_scale = static_cast<BaseFloat>(pitch_scale);
+    opts.pov_scale = static_cast<BaseFloat>(pov_scale);
+    opts.pov_offset = static_cast<BaseFloat>(pov_offset);
+    opts.delta_pitch_scale = static_cast<BaseFloat>(delta_pitch_scale);
+    opts.delta_pitch_noise_stddev = static_cast<BaseFloat>(delta_pitch_noise_stddev);
+    opts.normalization_left_context = static_cast<int32>(normalization_left_context);
+    opts.normalization_right_context = static_cast<int32>(normalization_right_context);
+    opts.delta_window = static_cast<int32>(delta_window);
+    opts.delay = static_cast<int32>(delay);
+    opts.add_pov_feature = add_pov_feature;
+    opts.add_normalized_log_pitch = add_normalized_log_pitch;
+    opts.add_delta_pitch = add_delta_pitch;
+    opts.add_raw_log_pitch = add_raw_log_pitch;
+    kaldi::Matrix<kaldi::BaseFloat> output;
+    if (method == "reference") {
+      kaldi::ProcessPitch(opts, feats, &output);
+    } else if (method == "approximate") {
+      kaldi::ProcessPitchApproximate(opts, feats, &output);
+    } else {
+      TORCH_CHECK(false, "Unknown method: ", method,
+                  " (expected 'reference' or 'approximate')");
+    }
     return output.tensor_;
   }
 
+  // The CMVN stats of the groups of `feats` (e.g. speakers), as a
+  // [num_groups, 2, dim + 1] tensor; groups[i] is the group of feats[i].
+  // `weights` is empty or holds the frame weights of each of `feats`.
+  torch::Tensor ComputeCmvnStats(
+      const std::vector<torch::Tensor> &feats,
+      const std::vector<torch::Tensor> &weights,
+      const std::vector<int64_t> &groups,
+      int64_t num_groups,
+      int64_t num_threads
+  ) {
+    TORCH_CHECK(!feats.empty(), "No features.");
+    TORCH_CHECK(groups.size() == feats.size(), "Wrong number of groups.");
+    TORCH_CHECK(weights.empty() || weights.size() == feats.size(),
+                "Wrong number of weights.");
+    // The features can be stored as float, float16 or bfloat16, all with the
+    // same dtype; they are widened as they are read.
+    const int32 dim = feats[0].size(1);
+    std::vector<torch::Tensor> inputs;
+    std::vector<kaldi::VectorBase<BaseFloat>> input_weights;
+    std::vector<int32> input_groups;
+    for (size_t i = 0; i < feats.size(); i++) {
+      inputs.push_back(feats[i].contiguous());
+      TORCH_CHECK(inputs.back().dim() == 2 && inputs.back().size(1) == dim,
+                  "Dimension mismatch.");
+      TORCH_CHECK(inputs.back().scalar_type() == inputs[0].scalar_type(),
+                  "The features must have the same dtype.");
+      if (!weights.empty())
+        input_weights.emplace_back(weights[i].contiguous());
+      input_groups.push_back(static_cast<int32>(groups[i]));
+    }
+    std::vector<const kaldi::VectorBase<BaseFloat>*> weight_ptrs;
+    for (auto &input_weight : input_weights)
+      weight_ptrs.push_back(&input_weight);
+    auto output = torch::zeros({num_groups, 2, dim + 1}, torch::kFloat64);
+    std::vector<kaldi::MatrixBase<double>> stats;
+    for (int64_t g = 0; g < num_groups; g++)
+      stats.emplace_back(output[g]);
+    std::vector<kaldi::MatrixBase<double>*> stats_ptrs;
+    for (auto &group_stats : stats)
+      stats_ptrs.push_back(&group_stats);
+    DispatchStorage(inputs[0], [&](const auto &first) {
+      std::vector<typename std::decay<decltype(first)>::type> views;
+      for (const auto &input : inputs)
+        views.emplace_back(input);
+      kaldi::AccCmvnStatsBatch(views, weight_ptrs, input_groups,
+                               static_cast<int32>(num_threads), stats_ptrs);
+    });
+    return output;
+  }
+
+  // Normalizes each of `feats` in place with stats[groups[i]].
+  void ApplyCmvn_(
+      const std::vector<torch::Tensor> &feats,
+      const torch::Tensor &stats,
+      const std::vector<int64_t> &groups,
+      bool norm_vars,
+      bool reverse,
+      int64_t num_threads
+  ) {
+    TORCH_CHECK(groups.size() == feats.size(), "Wrong number of groups.");
+    TORCH_CHECK(stats.dim() == 3, "Expected stats of shape [groups, 2, dim + 1].");
+    std::vector<kaldi::MatrixBase<double>> group_stats;
+    for (int64_t g = 0; g < stats.size(0); g++)
+      group_stats.emplace_back(stats[g]);
+    std::vector<kaldi::MatrixBase<BaseFloat>> outputs;
+    for (const auto &feat : feats) {
+      TORCH_CHECK(feat.dim() == 2 && feat.stride(1) == 1,
+                  "Features must be matrices with contiguous rows.");
+      outputs.emplace_back(feat);
+    }
+    std::vector<const kaldi::MatrixBase<double>*> stats_ptrs;
+    std::vector<kaldi::MatrixBase<BaseFloat>*> output_ptrs;
+    for (size_t i = 0; i < feats.size(); i++) {
+      TORCH_CHECK(groups[i] >= 0 && groups[i] < stats.size(0), "Invalid group.");
+      stats_ptrs.push_back(&group_stats[groups[i]]);
+      output_ptrs.push_back(&outputs[i]);
+    }
+    kaldi::ApplyCmvnBatch(stats_ptrs, norm_vars, reverse,
+                          static_cast<int32>(num_threads), output_ptrs);
+  }
+
+  // The number of storage reallocations made by the last op call on this thread.
+  int64_t NumReallocations() {
+    return kaldi::GetResizeStats().num_reallocations;
+  }
+
+  kaldi::MatrixResizeType ParseResizeType(const std::string &resize_type) {
+    if (resize_type == "set_zero") return kaldi::kSetZero;
+    if (resize_type == "undefined") return kaldi::kUndefined;
+    TORCH_CHECK(resize_type == "copy_data", "Unknown resize type: ", resize_type);
+    return kaldi::kCopyData;
+  }
+
+  // kaldi::Vector and kaldi::Matrix, so that their storage management can be
+  // tested from Python. Like the ops, resize() and reserve() reset the
+  // counters read by NumReallocations.
+  struct VectorHolder : torch::CustomClassHolder {
+    kaldi::Vector<BaseFloat> vector;
+
+    // A copy of `data`, made by the copy constructor.
+    explicit VectorHolder(const torch::Tensor &data)
+      : vector(kaldi::VectorBase<BaseFloat>(data)) {}
+
+    void Resize(int64_t length, const std::string &resize_type) {
+      kaldi::GetResizeStats() = kaldi::ResizeStats();
+      vector.Resize(static_cast<int32>(length), ParseResizeType(resize_type));
+    }
+
+    void Reserve(int64_t capacity) {
+      kaldi::GetResizeStats() = kaldi::ResizeStats();
+      vector.Reserve(static_cast<int32>(capacity));
+    }
+
+    // A view of the elements, not a copy.
+    torch::Tensor Data() const { return vector.tensor_; }
+  };
+
+  struct MatrixHolder : torch::CustomClassHolder {
+    std::unique_ptr<kaldi::Matrix<BaseFloat>> matrix;
+
+    // A copy of `data` (float32 or float64), made by the copy constructors.
+    MatrixHolder(const torch::Tensor &data, bool transpose) {
+      const auto trans = transpose ? kaldi::kTrans : kaldi::kNoTrans;
+      if (data.scalar_type() == torch::kFloat64) {
+        matrix.reset(new kaldi::Matrix<BaseFloat>(
+          kaldi::MatrixBase<double>(data), trans));
+      } else {
+        matrix.reset(new kaldi::Matrix<BaseFloat>(
+          kaldi::MatrixBase<BaseFloat>(data), trans));
+      }
+    }
+
+    void Resize(int64_t num_rows, int64_t num_cols,
+                const std::string &resize_type) {
+      kaldi::GetResizeStats() = kaldi::ResizeStats();
+      matrix->Resize(static_cast<int32>(num_rows), static_cast<int32>(num_cols),
+                     ParseResizeType(resize_type));
+    }
+
+    void Reserve(int64_t num_rows, int64_t num_cols) {
+      kaldi::GetResizeStats() = kaldi::ResizeStats();
+      matrix->Reserve(static_cast<int32>(num_rows), static_cast<int32>(num_cols));
+    }
+
+    // A view of the elements, not a copy.
+    torch::Tensor Data() const { return matrix->tensor_; }
+  };
+
 } // namespace tkaldi
 
 TORCH_LIBRARY(tkaldi, m) {
+  m.class_<tkaldi::FeatureCacheHolder>("FeatureCache")
+    .def(torch::init<std::string, int64_t>())
+    .def("stats", &tkaldi::FeatureCacheHolder::Stats);
+  m.class_<tkaldi::AsyncPoolHolder>("AsyncPool")
+    .def(torch::init<int64_t, int64_t>())
+    .def("num_pending", &tkaldi::AsyncPoolHolder::NumPending);
+  m.class_<tkaldi::NpyArchiveHolder>("NpyArchive")
+    .def(torch::init<std::string>())
+    .def("keys", &tkaldi::NpyArchiveHolder::Keys)
+    .def("contains", &tkaldi::NpyArchiveHolder::Contains)
+    .def("get", &tkaldi::NpyArchiveHolder::Get)
+    .def("size", &tkaldi::NpyArchiveHolder::Size);
+  m.class_<tkaldi::NpyArchiveWriterHolder>("NpyArchiveWriter")
+    .def(torch::init<std::string>())
+    .def("write", &tkaldi::NpyArchiveWriterHolder::Write)
+    .def("close", &tkaldi::NpyArchiveWriterHolder::Close);
+  m.class_<tkaldi::VectorHolder>("Vector")
+    .def(torch::init<torch::Tensor>())
+    .def("resize", &tkaldi::VectorHolder::Resize)
+    .def("reserve", &tkaldi::VectorHolder::Reserve)
+    .def("data", &tkaldi::VectorHolder::Data);
+  m.class_<tkaldi::MatrixHolder>("Matrix")
+    .def(torch::init<torch::Tensor, bool>())
+    .def("resize", &tkaldi::MatrixHolder::Resize)
+    .def("reserve", &tkaldi::MatrixHolder::Reserve)
+    .def("data", &tkaldi::MatrixHolder::Data);
+  m.def("tkaldi::ReadWave", &tkaldi::ReadWave);
+  m.def("tkaldi::ReadNpy", &tkaldi::ReadNpy);
+  m.def("tkaldi::WriteNpy", &tkaldi::WriteNpy);
   m.def("tkaldi::ResampleWaveform", &tkaldi::ResampleWaveform);
+  m.def("tkaldi::ArbitraryResample", &tkaldi::ArbitraryResample);
   m.def("tkaldi::ComputeKaldiPitch", &tkaldi::ComputeKaldiPitch);
+  m.def("tkaldi::ComputeKaldiPitchCached", &tkaldi::ComputeKaldiPitchCached);
+  m.def("tkaldi::ResampleWaveformAsync(Tensor wave, "
+        "__torch__.torch.classes.tkaldi.AsyncPool pool, bool block, "
+        "float orig_freq, float new_freq) -> Future(Tensor)",
+        torch::CppFunction::makeFromBoxedFunction<&tkaldi::BoxedAsync<
+          decltype(tkaldi::ResampleWaveformAsync),
+          &tkaldi::ResampleWaveformAsync>>());
+  m.def("tkaldi::ComputeKaldiPitchAsync(Tensor wave, "
+        "__torch__.torch.classes.tkaldi.AsyncPool pool, bool block, "
+        "float sample_frequency, float frame_length, float frame_shift, "
+        "float preemphasis_coefficient, float min_f0, float max_f0, "
+        "float soft_min_f0, float penalty_factor, float lowpass_cutoff, "
+        "float resample_frequency, float delta_pitch, float nccf_ballast, "
+        "int lowpass_filter_width, int upsample_filter_width, "
+        "int max_frames_latency, int frames_per_chunk, "
+        "bool simulate_first_pass_online, int recompute_frame, "
+        "bool nccf_ballast_online, bool snip_edges) -> Future(Tensor)",
+        torch::CppFunction::makeFromBoxedFunction<&tkaldi::BoxedAsync<
+          decltype(tkaldi::ComputeKaldiPitchAsync),
+          &tkaldi::ComputeKaldiPitchAsync>>());
+  m.def("tkaldi::ComputeKaldiPitchBatch", &tkaldi::ComputeKaldiPitchBatch);
+  m.def("tkaldi::LastBatchUtilization", &tkaldi::LastBatchUtilization);
+  m.def("tkaldi::ProcessPitch", &tkaldi::ProcessPitch);
+  m.def("tkaldi::ComputeCmvnStats", &tkaldi::ComputeCmvnStats);
+  m.def("tkaldi::ApplyCmvn_(Tensor(a!)[] feats, Tensor stats, int[] groups, "
+        "bool norm_vars, bool reverse, int num_threads) -> ()",
+        &tkaldi::ApplyCmvn_);
+  m.def("tkaldi::NumReallocations", &tkaldi::NumReallocations);
 }
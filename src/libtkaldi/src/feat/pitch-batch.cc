@@ -0,0 +1,155 @@
+// feat/pitch-batch.cc
+
+// Not in Kaldi.
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include "feat/pitch-batch.h"
+
+namespace kaldi {
+
+namespace {
+
+// The frames of a chunk overlapping the previous/next chunk which are
+// dropped are affected by the zero padding and by the resampling filter at
+// the chunk edges; this is the least we need for that.
+const int32 kMinOverlapFrames = 10;
+
+// A part of an utterance, processed as one task.
+struct PitchChunk {
+  int32 utt;
+  int64 sample_offset;
+  int64 num_samples;
+  int32 frame_offset;  // index of the first frame of the chunk in the utterance
+  int32 keep_begin;    // the range of frames of the utterance taken from
+  int32 keep_end;      // this chunk.
+  Matrix<BaseFloat> pitch;
+};
+
+// Appends the chunks of an utterance of `num_samples` samples to `chunks`.
+void SplitUtterance(const PitchExtractionOptions &opts,
+                    const PitchBatchOptions &batch_opts,
+                    int32 utt, int64 num_samples,
+                    std::vector<PitchChunk> *chunks) {
+  PitchChunk chunk;
+  chunk.utt = utt;
+  chunk.sample_offset = 0;
+  chunk.num_samples = num_samples;
+  chunk.frame_offset = 0;
+  chunk.keep_begin = 0;
+  chunk.keep_end = std::numeric_limits<int32>::max();
+
+  // Chunks start on frame boundaries, both in the input and in the resampled
+  // signal, so that their frames line up with the frames of the utterance.
+  const double frame_shift = opts.samp_freq * opts.frame_shift_ms / 1000.0,
+    resampled_frame_shift = opts.resample_freq * opts.frame_shift_ms / 1000.0;
+  const bool aligned = frame_shift == std::floor(frame_shift) &&
+    resampled_frame_shift == std::floor(resampled_frame_shift);
+  const int32 chunk_frames = static_cast<int32>(
+    batch_opts.max_chunk_length * 1000.0 / opts.frame_shift_ms);
+  const int32 overlap_frames = std::max(kMinOverlapFrames, static_cast<int32>(
+    batch_opts.chunk_overlap * 1000.0 / opts.frame_shift_ms));
+  const int64 shift = static_cast<int64>(frame_shift);
+
+  if (batch_opts.max_chunk_length <= 0.0 || !aligned ||
+      chunk_frames <= 2 * overlap_frames ||
+      num_samples <= chunk_frames * shift) {
+    if (batch_opts.max_chunk_length > 0.0 && !aligned)
+      KALDI_WARN << "Not splitting utterance: the frame shift is not a whole "
+                 << "number of samples.";
+    chunks->push_back(chunk);
+    return;
+  }
+  const int32 stride = chunk_frames - overlap_frames;
+  for (int32 frame = 0; ; frame += stride) {
+    chunk.sample_offset = frame * shift;
+    chunk.num_samples = std::min<int64>((frame + chunk_frames) * shift,
+                                        num_samples) - chunk.sample_offset;
+    chunk.frame_offset = frame;
+    chunk.keep_begin = frame == 0 ? 0 : frame + overlap_frames / 2;
+    const bool last = chunk.sample_offset + chunk.num_samples == num_samples;
+    chunk.keep_end = last ? std::numeric_limits<int32>::max() :
+      frame + stride + overlap_frames / 2;
+    chunks->push_back(chunk);
+    if (last) break;
+  }
+}
+
+// Copies the frames kept from the chunks of one utterance to `output`.
+void MergeChunks(const std::vector<PitchChunk> &chunks, size_t begin,
+                 size_t end, Matrix<BaseFloat> *output) {
+  const PitchChunk &last = chunks[end - 1];
+  const int32 num_frames = last.frame_offset + last.pitch.NumRows();
+  output->Resize(num_frames, 2, kUndefined);
+  int32 next_frame = 0;
+  for (size_t i = begin; i < end; i++) {
+    const PitchChunk &chunk = chunks[i];
+    int32 first = std::max(chunk.keep_begin, chunk.frame_offset),
+      limit = std::min<int64>(chunk.keep_end,
+                              chunk.frame_offset + chunk.pitch.NumRows());
+    if (first != next_frame || limit < first)
+      KALDI_ERR << "Chunk overlap too short: frames " << next_frame
+                << " to " << first << " are missing.";
+    if (limit > first)
+      output->RowRange(first, limit - first).CopyFromMat(
+        chunk.pitch.RowRange(first - chunk.frame_offset, limit - first));
+    next_frame = limit;
+  }
+  KALDI_ASSERT(next_frame == num_frames);
+}
+
+} // namespace
+
+void ComputeKaldiPitchBatch(const PitchExtractionOptions &opts,
+                            const PitchBatchOptions &batch_opts,
+                            const std::vector<const VectorBase<BaseFloat>*> &waves,
+                            std::vector<Matrix<BaseFloat> > *outputs,
+                            std::vector<bool> *succeeded,
+                            SchedulerStats *stats) {
+  const int32 num_utts = waves.size();
+  std::vector<PitchChunk> chunks;
+  for (int32 utt = 0; utt < num_utts; utt++)
+    SplitUtterance(opts, batch_opts, utt, waves[utt]->Dim(), &chunks);
+
+  // Set by the worker of a failed chunk, and read by the workers of the other
+  // chunks of the same utterance, which are then skipped.
+  std::vector<std::atomic<bool> > failed(num_utts);
+  for (auto &flag : failed) flag = false;
+  ExecutionContext context(batch_opts.execution);
+  WorkStealingScheduler scheduler(batch_opts.num_threads);
+  context.Configure(&scheduler);
+  for (auto &chunk : chunks) {
+    PitchChunk *c = &chunk;
+    scheduler.AddTask(chunk.num_samples, [&opts, &waves, &failed, succeeded, c]() {
+      if (succeeded != NULL && failed[c->utt]) return;
+      SubVector<BaseFloat> wave(*waves[c->utt], c->sample_offset, c->num_samples);
+      if (succeeded == NULL) {
+        ComputeKaldiPitch(opts, wave, &c->pitch);
+        return;
+      }
+      try {
+        ComputeKaldiPitch(opts, wave, &c->pitch);
+      } catch (...) {
+        failed[c->utt] = true;
+      }
+    });
+  }
+  scheduler.Run(stats);
+
+  outputs->resize(num_utts);
+  if (succeeded != NULL) succeeded->assign(num_utts, true);
+  for (size_t begin = 0, end; begin < chunks.size(); begin = end) {
+    const int32 utt = chunks[begin].utt;
+    for (end = begin + 1; end < chunks.size() && chunks[end].utt == utt; end++);
+    if (failed[utt]) {
+      (*outputs)[utt].Resize(0, 0);
+      (*succeeded)[utt] = false;
+    } else {
+      MergeChunks(chunks, begin, end, &(*outputs)[utt]);
+    }
+  }
+}
+
+} // namespace kaldi
@@ -0,0 +1,59 @@
+// feat/pitch-batch.h
+
+// Not in Kaldi.
+//
+// Pitch extraction over a batch of utterances with a WorkStealingScheduler.
+
+#ifndef KALDI_FEAT_PITCH_BATCH_H_
+#define KALDI_FEAT_PITCH_BATCH_H_
+
+#include <vector>
+#include "feat/pitch-functions.h"
+#include "itf/options-itf.h"
+#include "util/execution-context.h"
+#include "util/work-stealing-scheduler.h"
+
+namespace kaldi {
+
+struct PitchBatchOptions {
+  int32 num_threads;
+  BaseFloat max_chunk_length;
+  BaseFloat chunk_overlap;
+  ExecutionOptions execution;
+
+  PitchBatchOptions():
+      num_threads(1),
+      max_chunk_length(0.0),
+      chunk_overlap(1.0) {}
+
+  void Register(OptionsItf *opts) {
+    opts->Register("num-threads", &num_threads,
+                   "Number of threads used to process the utterances.");
+    opts->Register("max-chunk-length", &max_chunk_length,
+                   "If > 0, utterances longer than this many seconds are split "
+                   "into overlapping chunks processed in parallel.  The pitch "
+                   "in each chunk is tracked separately, so the result is an "
+                   "approximation of processing the whole utterance.");
+    opts->Register("chunk-overlap", &chunk_overlap,
+                   "Overlap in seconds between consecutive chunks, see "
+                   "--max-chunk-length.  The frames of the overlap are taken "
+                   "half from each chunk.");
+    execution.Register(opts);
+  }
+};
+
+/// Computes the pitch of each of `waves` into the corresponding element of
+/// `outputs`, as ComputeKaldiPitch() would (unless max_chunk_length splits
+/// the long ones).
+/// If `succeeded` is not NULL, utterances which fail are reported there and
+/// get an empty output; otherwise the first error is re-thrown.
+void ComputeKaldiPitchBatch(const PitchExtractionOptions &opts,
+                            const PitchBatchOptions &batch_opts,
+                            const std::vector<const VectorBase<BaseFloat>*> &waves,
+                            std::vector<Matrix<BaseFloat> > *outputs,
+                            std::vector<bool> *succeeded = NULL,
+                            SchedulerStats *stats = NULL);
+
+} // namespace kaldi
+
+#endif
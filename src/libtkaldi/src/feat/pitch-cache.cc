@@ -0,0 +1,51 @@
+// feat/pitch-cache.cc
+
+// Not in Kaldi.
+
+#include <limits>
+#include <sstream>
+#include "feat/pitch-cache.h"
+
+namespace kaldi {
+
+std::string PitchOptionsString(const PitchExtractionOptions &opts) {
+  std::ostringstream os;
+  os.precision(std::numeric_limits<BaseFloat>::max_digits10);
+  // Bump the version when the output of ComputeKaldiPitch changes, to
+  // invalidate the existing entries.
+  os << "ComputeKaldiPitch/1"
+     << " samp_freq=" << opts.samp_freq
+     << " frame_shift_ms=" << opts.frame_shift_ms
+     << " frame_length_ms=" << opts.frame_length_ms
+     << " preemph_coeff=" << opts.preemph_coeff
+     << " min_f0=" << opts.min_f0
+     << " max_f0=" << opts.max_f0
+     << " soft_min_f0=" << opts.soft_min_f0
+     << " penalty_factor=" << opts.penalty_factor
+     << " lowpass_cutoff=" << opts.lowpass_cutoff
+     << " resample_freq=" << opts.resample_freq
+     << " delta_pitch=" << opts.delta_pitch
+     << " nccf_ballast=" << opts.nccf_ballast
+     << " lowpass_filter_width=" << opts.lowpass_filter_width
+     << " upsample_filter_width=" << opts.upsample_filter_width
+     << " max_frames_latency=" << opts.max_frames_latency
+     << " frames_per_chunk=" << opts.frames_per_chunk
+     << " simulate_first_pass_online=" << opts.simulate_first_pass_online
+     << " recompute_frame=" << opts.recompute_frame
+     << " nccf_ballast_online=" << opts.nccf_ballast_online
+     << " snip_edges=" << opts.snip_edges;
+  return os.str();
+}
+
+void ComputeKaldiPitchCached(const PitchExtractionOptions &opts,
+                             const VectorBase<BaseFloat> &wave,
+                             FeatureCache *cache,
+                             Matrix<BaseFloat> *output) {
+  const std::string key = FeatureCache::Key(wave, PitchOptionsString(opts));
+  if (cache->Lookup(key, output))
+    return;
+  ComputeKaldiPitch(opts, wave, output);
+  cache->Insert(key, *output);
+}
+
+} // namespace kaldi
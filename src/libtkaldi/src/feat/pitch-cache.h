@@ -0,0 +1,28 @@
+// feat/pitch-cache.h
+
+// Not in Kaldi.
+//
+// Pitch extraction through a FeatureCache.
+
+#ifndef KALDI_FEAT_PITCH_CACHE_H_
+#define KALDI_FEAT_PITCH_CACHE_H_
+
+#include <string>
+#include "feat/pitch-functions.h"
+#include "util/feature-cache.h"
+
+namespace kaldi {
+
+/// A canonical serialization of all the options, for FeatureCache::Key().
+std::string PitchOptionsString(const PitchExtractionOptions &opts);
+
+/// ComputeKaldiPitch(), returning the cached features if `wave` was already
+/// processed with the same options, and caching the result otherwise.
+void ComputeKaldiPitchCached(const PitchExtractionOptions &opts,
+                             const VectorBase<BaseFloat> &wave,
+                             FeatureCache *cache,
+                             Matrix<BaseFloat> *output);
+
+} // namespace kaldi
+
+#endif
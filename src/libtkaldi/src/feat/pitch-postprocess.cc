@@ -0,0 +1,113 @@
+// feat/pitch-postprocess.cc
+
+// Not in Kaldi.
+
+#include <vector>
+#include "base/kaldi-math.h"
+#include "feat/pitch-postprocess.h"
+
+#ifndef KALDI_LEAN_STORAGE
+namespace kaldi {
+
+namespace {
+
+const int32 kRawPitchDim = 2;  // (NCCF, pitch)
+
+// The first order delta window of DeltaFeatures, computed the same way.
+std::vector<BaseFloat> DeltaScales(int32 window) {
+  KALDI_ASSERT(window > 0);
+  std::vector<BaseFloat> scales(2 * window + 1, 0.0);
+  BaseFloat normalizer = 0.0;
+  for (int32 j = -window; j <= window; j++) {
+    normalizer += j * j;
+    scales[j + window] += static_cast<BaseFloat>(j) * 1.0f;
+  }
+  const BaseFloat alpha = 1.0 / normalizer;
+  for (auto &scale : scales)
+    scale *= alpha;
+  return scales;
+}
+
+int32 FeatureDim(const ProcessPitchOptions &opts) {
+  return (opts.add_pov_feature ? 1 : 0)
+    + (opts.add_normalized_log_pitch ? 1 : 0)
+    + (opts.add_delta_pitch ? 1 : 0)
+    + (opts.add_raw_log_pitch ? 1 : 0);
+}
+
+} // namespace
+
+void ProcessPitchApproximate(const ProcessPitchOptions &opts,
+                             const MatrixBase<BaseFloat> &input,
+                             Matrix<BaseFloat> *output) {
+  KALDI_ASSERT(input.NumCols() == kRawPitchDim);
+  const int32 dim = FeatureDim(opts), num_frames = input.NumRows();
+  KALDI_ASSERT(dim > 0);
+  if (num_frames == 0) {
+    output->Resize(0, dim);
+    return;
+  }
+  const auto nccf = input.tensor_.select(1, 0).to(torch::kFloat64),
+    pitch = input.tensor_.select(1, 1);
+  KALDI_ASSERT(pitch.gt(0).all().item<bool>());
+  const auto log_pitch = pitch.log();
+  std::vector<torch::Tensor> columns;
+
+  if (opts.add_pov_feature) {
+    auto f = (1.0001 - nccf.clamp(-1.0, 1.0)).pow(0.15) - 1.0;
+    columns.push_back(opts.pov_scale * f.to(torch::kFloat32) + opts.pov_offset);
+  }
+  if (opts.add_normalized_log_pitch) {
+    // NccfToPov()
+    auto n = nccf.abs().clamp_max(1.0);
+    auto r = -5.2 + 5.4 * (7.5 * (n - 1.0)).exp() + 4.8 * n -
+      2.0 * (-10.0 * n).exp() + 4.2 * (20.0 * (n - 1.0)).exp();
+    r = r.to(torch::kFloat32).to(torch::kFloat64);
+    auto pov = (1.0 / (1.0 + (-r).exp())).to(torch::kFloat32);
+    // Sums over the window [t - left_context, t + right_context] of every
+    // frame t, as differences of cumulative sums.
+    auto zero = torch::zeros({1}, torch::kFloat64);
+    auto cum_pov = torch::cat({zero, pov.to(torch::kFloat64).cumsum(0)}),
+      cum_log_pitch_pov = torch::cat(
+        {zero, (pov * log_pitch).to(torch::kFloat64).cumsum(0)});
+    auto t = torch::arange(num_frames, torch::kLong);
+    auto begin = (t - opts.normalization_left_context).clamp_min(0),
+      end = (t + opts.normalization_right_context + 1).clamp_max(num_frames);
+    auto avg_log_pitch =
+      (cum_log_pitch_pov.index({end}) - cum_log_pitch_pov.index({begin})) /
+      (cum_pov.index({end}) - cum_pov.index({begin}));
+    columns.push_back(
+      (log_pitch - avg_log_pitch.to(torch::kFloat32)) * opts.pitch_scale);
+  }
+  if (opts.add_delta_pitch) {
+    const int32 context = opts.delta_window;
+    const std::vector<BaseFloat> scales = DeltaScales(context);
+    auto t = torch::arange(num_frames, torch::kLong);
+    auto delta = torch::zeros({num_frames}, torch::kFloat32);
+    for (int32 j = -context; j <= context; j++) {
+      if (scales[j + context] != 0.0) {
+        auto index = (t + j).clamp(0, num_frames - 1);
+        delta += scales[j + context] * log_pitch.index({index});
+      }
+    }
+    // Drawn in the same order as OnlineProcessPitch does.
+    auto noise = torch::empty({num_frames}, torch::kFloat32);
+    BaseFloat *noise_data = noise.data_ptr<BaseFloat>();
+    for (int32 i = 0; i < num_frames; i++)
+      noise_data[i] = RandGauss() * opts.delta_pitch_noise_stddev;
+    columns.push_back((delta + noise) * opts.delta_pitch_scale);
+  }
+  if (opts.add_raw_log_pitch)
+    columns.push_back(log_pitch);
+
+  auto feats = torch::stack(columns, 1);
+  if (opts.delay > 0) {
+    auto index = (torch::arange(num_frames + opts.delay, torch::kLong)
+                  - opts.delay).clamp_min(0);
+    feats = feats.index({index});
+  }
+  output->Resize(feats.size(0), dim, kUndefined);
+  output->tensor_.copy_(feats);
+}
+} // namespace kaldi
+#endif  // KALDI_LEAN_STORAGE
@@ -0,0 +1,31 @@
+// feat/pitch-postprocess.h
+
+// Not in Kaldi.
+//
+// An approximation of ProcessPitch for whole utterances.
+//
+// ProcessPitchApproximate computes the same features as ProcessPitch with
+// tensor operations, using cumulative sums for the normalization window and
+// its own tensor version of NccfToPov(). The sums and the transcendental
+// functions are evaluated differently, so its output matches ProcessPitch
+// only up to rounding (about 1e-5); use ProcessPitch where the features must
+// be identical to Kaldi's. It is not available with the lean storage
+// (KALDI_LEAN_STORAGE), which has no tensors.
+
+#ifndef KALDI_FEAT_PITCH_POSTPROCESS_H_
+#define KALDI_FEAT_PITCH_POSTPROCESS_H_
+
+#include "feat/pitch-functions.h"
+
+namespace kaldi {
+
+#ifndef KALDI_LEAN_STORAGE
+/// Same as ProcessPitch() up to rounding, computed with tensor operations.
+void ProcessPitchApproximate(const ProcessPitchOptions &opts,
+                             const MatrixBase<BaseFloat> &input,
+                             Matrix<BaseFloat> *output);
+#endif
+
+} // namespace kaldi
+
+#endif
@@ -0,0 +1,133 @@
+// feat/resample-banded.cc
+
+// Not in Kaldi.
+
+#include <cmath>
+#include "base/kaldi-math.h"
+#include "feat/resample-banded.h"
+
+namespace kaldi {
+
+namespace {
+
+// ArbitraryResample::FilterFunc(): a windowed sinc filter, with the same
+// types and expressions so that the weights are bit-identical.
+BaseFloat FilterFunc(BaseFloat t, BaseFloat filter_cutoff, int32 num_zeros) {
+  BaseFloat window, filter;
+  if (std::abs(t) < num_zeros / (2.0 * filter_cutoff))
+    window = 0.5 * (1 + cos(M_2PI * filter_cutoff / num_zeros * t));
+  else
+    window = 0.0;
+  if (t != 0.0)
+    filter = sin(M_2PI * filter_cutoff * t) / (M_PI * t);
+  else
+    filter = 2.0 * filter_cutoff;
+  return filter * window;
+}
+
+}  // namespace
+
+BandedResample::BandedResample(int32 num_samples_in,
+                               BaseFloat samp_rate_hz,
+                               BaseFloat filter_cutoff_hz,
+                               const Vector<BaseFloat> &sample_points_secs,
+                               int32 num_zeros) {
+  KALDI_ASSERT(num_samples_in > 0 && samp_rate_hz > 0.0 &&
+               filter_cutoff_hz > 0.0 &&
+               filter_cutoff_hz * 2.0 <= samp_rate_hz && num_zeros > 0);
+  const int32 num_in = num_samples_in, num_out = sample_points_secs.Dim();
+  // The band of each output sample as in ArbitraryResample::SetIndexes(), and
+  // its weights as in ArbitraryResample::SetWeights(). The band may end with
+  // zero weights, which are kept: the matrix-vector products of Resample()
+  // must have the same size as ArbitraryResample's for the sums to be the
+  // same.
+  const BaseFloat filter_width = num_zeros / (2.0 * filter_cutoff_hz);
+  first_index_.resize(num_out);
+  band_weights_.resize(num_out);
+  weights_.Resize(num_in, num_out);
+  BaseFloat *data = weights_.Data();
+  const MatrixIndexT stride = weights_.Stride();
+  for (int32 i = 0; i < num_out; i++) {
+    BaseFloat t = sample_points_secs(i),
+      t_min = t - filter_width, t_max = t + filter_width;
+    int32 index_min = ceil(samp_rate_hz * t_min),
+      index_max = floor(samp_rate_hz * t_max);
+    if (index_min < 0)
+      index_min = 0;
+    if (index_max >= num_in)
+      index_max = num_in - 1;
+    first_index_[i] = index_min;
+    band_weights_[i].Resize(index_max - index_min + 1, kUndefined);
+    BaseFloat *w = band_weights_[i].Data();
+    for (int32 j = 0; j <= index_max - index_min; j++) {
+      BaseFloat delta_t = t - (index_min + j) / samp_rate_hz;
+      w[j] = FilterFunc(delta_t, filter_cutoff_hz, num_zeros) / samp_rate_hz;
+      data[(index_min + j) * stride + i] = w[j];
+    }
+  }
+}
+
+void BandedResample::Resample(const MatrixBase<BaseFloat> &input,
+                              MatrixBase<BaseFloat> *output) const {
+  KALDI_ASSERT(input.NumRows() == output->NumRows() &&
+               input.NumCols() == NumSamplesIn() &&
+               output->NumCols() == NumSamplesOut());
+  const int32 num_rows = input.NumRows(), num_out = NumSamplesOut();
+  if (num_rows == 0) return;
+  // The same products as ArbitraryResample::Resample().
+  Vector<BaseFloat> output_col(num_rows);
+  for (int32 i = 0; i < num_out; i++) {
+    SubMatrix<BaseFloat> input_part(input, 0, num_rows, first_index_[i],
+                                    band_weights_[i].Dim());
+    output_col.AddMatVec(1.0, input_part, kNoTrans, band_weights_[i], 0.0);
+    output->CopyColFromVec(output_col, i);
+  }
+}
+
+template<typename Storage>
+void BandedResample::ResampleFused(const StorageMatrix<Storage> &input,
+                                   MatrixBase<BaseFloat> *output) const {
+  KALDI_ASSERT(input.num_rows == output->NumRows() &&
+               input.num_cols == NumSamplesIn() &&
+               output->NumCols() == NumSamplesOut());
+  const int32 num_rows = input.num_rows, num_out = NumSamplesOut();
+  BaseFloat *out = output->Data();
+  const MatrixIndexT out_stride = output->Stride();
+  for (int32 r = 0; r < num_rows; r++) {
+    const Storage *in_row = input.RowData(r);
+    BaseFloat *out_row = out + static_cast<size_t>(r) * out_stride;
+    for (int32 i = 0; i < num_out; i++) {
+      const Storage *x = in_row + first_index_[i];
+      const BaseFloat *w = band_weights_[i].Data();
+      const int32 num_taps = band_weights_[i].Dim();
+      BaseFloat sum = 0.0;
+      for (int32 j = 0; j < num_taps; j++)
+        sum += static_cast<BaseFloat>(x[j]) * w[j];
+      out_row[i] = sum;
+    }
+  }
+}
+
+#ifndef KALDI_LEAN_STORAGE
+void BandedResample::ResampleMatMul(const MatrixBase<BaseFloat> &input,
+                                    MatrixBase<BaseFloat> *output) const {
+  KALDI_ASSERT(input.NumRows() == output->NumRows() &&
+               input.NumCols() == NumSamplesIn() &&
+               output->NumCols() == NumSamplesOut());
+  torch::mm_out(output->tensor_, input.tensor_, weights_.tensor_);
+}
+#endif
+
+template
+void BandedResample::ResampleFused(const StorageMatrix<float> &input,
+                                   MatrixBase<BaseFloat> *output) const;
+#ifndef KALDI_LEAN_STORAGE
+template
+void BandedResample::ResampleFused(const StorageMatrix<c10::Half> &input,
+                                   MatrixBase<BaseFloat> *output) const;
+template
+void BandedResample::ResampleFused(const StorageMatrix<c10::BFloat16> &input,
+                                   MatrixBase<BaseFloat> *output) const;
+#endif
+
+} // namespace kaldi
@@ -0,0 +1,78 @@
+// feat/resample-banded.h
+
+// Not in Kaldi.
+//
+// ArbitraryResample stores, for each output sample, the index of its first
+// input sample and a vector of weights, and its Resample() makes one
+// matrix-vector product per output sample. The pitch extractor uses it to
+// upsample the NCCF of all the frames of a chunk from integer lags to the
+// log-spaced lag grid.
+//
+// BandedResample takes the same arguments and computes the same weights, the
+// same way. Its Resample() makes the same matrix-vector products, so that its
+// output is bit-identical; it is not faster than ArbitraryResample. The other
+// kernels sum in a different order, so their output matches that of
+// ArbitraryResample up to rounding only, and callers opt into them:
+// ResampleFused() visits the band of each output sample row by row and also
+// takes an input stored in reduced precision, and ResampleMatMul() multiplies
+// by the weights as one dense matrix. The pitch extractor still uses
+// ArbitraryResample.
+
+#ifndef KALDI_FEAT_RESAMPLE_BANDED_H_
+#define KALDI_FEAT_RESAMPLE_BANDED_H_
+
+#include <vector>
+#include "feat/resample.h"
+#include "matrix/reduced-precision.h"
+
+namespace kaldi {
+
+class BandedResample {
+ public:
+  /// Same arguments as ArbitraryResample.
+  BandedResample(int32 num_samples_in,
+                 BaseFloat samp_rate_hz,
+                 BaseFloat filter_cutoff_hz,
+                 const Vector<BaseFloat> &sample_points_secs,
+                 int32 num_zeros);
+
+  int32 NumSamplesIn() const { return weights_.NumRows(); }
+
+  int32 NumSamplesOut() const { return weights_.NumCols(); }
+
+  /// Same as ArbitraryResample::Resample(), with the same result: each row of
+  /// `input` is resampled into the corresponding row of `output`.
+  void Resample(const MatrixBase<BaseFloat> &input,
+                MatrixBase<BaseFloat> *output) const;
+
+  /// Resamples each row of `input` in one pass over the bands of the output
+  /// samples, summing the products of each output sample in order. The
+  /// result matches that of Resample() up to rounding only. `input` may be
+  /// stored in reduced precision (see matrix/reduced-precision.h); each value
+  /// is widened to float as it is read.
+  template<typename Storage>
+  void ResampleFused(const StorageMatrix<Storage> &input,
+                     MatrixBase<BaseFloat> *output) const;
+
+#ifndef KALDI_LEAN_STORAGE
+  /// Computes input * Weights() with one matrix product. The result matches
+  /// that of Resample() up to rounding only.
+  void ResampleMatMul(const MatrixBase<BaseFloat> &input,
+                      MatrixBase<BaseFloat> *output) const;
+#endif
+
+  /// The weights as a dense num_samples_in x num_samples_out matrix, zero
+  /// outside the band.
+  const Matrix<BaseFloat> &Weights() const { return weights_; }
+
+ private:
+  Matrix<BaseFloat> weights_;
+  // As in ArbitraryResample: the weights of output sample i are
+  // band_weights_[i], applied to the inputs from first_index_[i].
+  std::vector<int32> first_index_;
+  std::vector<Vector<BaseFloat> > band_weights_;
+};
+
+} // namespace kaldi
+
+#endif
@@ -0,0 +1,197 @@
+// featbin/apply-cmvn.cc
+
+// Copyright 2009-2011  Microsoft Corporation
+
+// See https://github.com/kaldi-asr/kaldi/blob/7fb716aa0f56480af31514c7e362db5c9f787fd4/COPYING
+// for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+// Based on https://github.com/kaldi-asr/kaldi/blob/7fb716aa0f56480af31514c7e362db5c9f787fd4/src/featbin/apply-cmvn.cc
+//
+// Unlike the original, the utterances of a batch are normalized in parallel
+// with --num-threads threads, and with --norm-means=false the features are
+// copied as matrices (compressed input is not passed through). The output is
+// otherwise the same. The features can also be NumPy files (see
+// util/npy-table.h).
+
+#include <vector>
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "matrix/kaldi-matrix.h"
+#include "transform/cmvn.h"
+#include "util/npy-table.h"
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+
+    const char *usage =
+        "Apply cepstral mean and (optionally) variance normalization\n"
+        "Per-utterance by default, or per-speaker if utt2spk option provided\n"
+        "Usage: apply-cmvn [options] (<cmvn-stats-rspecifier>|<cmvn-stats-rxfilename>) "
+        "<feats-rspecifier> <feats-wspecifier>\n"
+        "e.g.: apply-cmvn --utt2spk=ark:data/train/utt2spk scp:data/train/cmvn.scp "
+        "scp:data/train/feats.scp ark:-\n"
+        "The features can also be read from and written to npz:<file> (a NumPy\n"
+        ".npz archive) or npy:<file> (a single .npy indexed by <file>.index)\n"
+        "See also: compute-cmvn-stats\n";
+
+    ParseOptions po(usage);
+    std::string utt2spk_rspecifier;
+    bool norm_vars = false;
+    bool norm_means = true;
+    bool reverse = false;
+    std::string skip_dims_str;
+    int32 num_threads = 1;
+    int32 batch_size = 256;
+
+    po.Register("utt2spk", &utt2spk_rspecifier,
+                "rspecifier for utterance to speaker map");
+    po.Register("norm-vars", &norm_vars, "If true, normalize variances.");
+    po.Register("norm-means", &norm_means, "You can set this to false to turn off mean "
+                "normalization.  Note, the same can be achieved by using 'fake' CMVN stats; "
+                "see the --fake option to compute_cmvn_stats.sh");
+    po.Register("skip-dims", &skip_dims_str, "Dimensions for which to skip "
+                "normalization: colon-separated list of integers, e.g. 13:14:15)");
+    po.Register("reverse", &reverse, "If true, apply CMVN in a reverse sense, "
+                "so as to transform normalized features back to original form.");
+    po.Register("num-threads", &num_threads,
+                "Number of threads used to normalize the utterances.");
+    po.Register("batch-size", &batch_size,
+                "Number of utterances read and processed together.");
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 3) {
+      po.PrintUsage();
+      exit(1);
+    }
+    if (norm_vars && !norm_means)
+      KALDI_ERR << "You cannot normalize the variance but not the mean.";
+    KALDI_ASSERT(batch_size > 0);
+
+    std::string cmvn_rspecifier_or_rxfilename = po.GetArg(1);
+    std::string feat_rspecifier = po.GetArg(2);
+    std::string feat_wspecifier = po.GetArg(3);
+
+    if (!norm_means) {
+      // CMVN is a no-op, we're not doing anything.  Just echo the input.
+      SequentialFeatureMatrixReader reader(feat_rspecifier);
+      FeatureMatrixWriter writer(feat_wspecifier);
+      kaldi::int32 num_done = 0;
+      for (;!reader.Done(); reader.Next()) {
+        writer.Write(reader.Key(), reader.Value());
+        num_done++;
+      }
+      KALDI_LOG << "Copied " << num_done << " utterances.";
+      return (num_done != 0 ? 0 : 1);
+    }
+
+    std::vector<int32> skip_dims;  // optionally use "fake"
+                                   // (zero-mean/unit-variance) stats for some
+                                   // dims to disable normalization.
+    if (!SplitStringToIntegers(skip_dims_str, ":", false, &skip_dims)) {
+      KALDI_ERR << "Bad --skip-dims option (should be colon-separated list of "
+                <<  "integers)";
+    }
+
+    kaldi::int32 num_done = 0, num_err = 0;
+
+    SequentialFeatureMatrixReader feat_reader(feat_rspecifier);
+    FeatureMatrixWriter feat_writer(feat_wspecifier);
+
+    // Global stats are read from a file, and apply to all utterances.
+    const bool global = ClassifyRspecifier(cmvn_rspecifier_or_rxfilename,
+                                           NULL, NULL) == kNoRspecifier;
+    std::vector<std::string> utts;
+    std::vector<Matrix<BaseFloat> > feats;
+    std::vector<Matrix<double> > cmvn_stats;  // per utterance, unless global
+
+    auto process_batch = [&]() {
+      std::vector<const MatrixBase<double>*> stats_ptrs;
+      std::vector<MatrixBase<BaseFloat>*> feats_ptrs;
+      for (size_t i = 0; i < feats.size(); i++) {
+        stats_ptrs.push_back(&cmvn_stats[global ? 0 : i]);
+        feats_ptrs.push_back(&feats[i]);
+      }
+      ApplyCmvnBatch(stats_ptrs, norm_vars, reverse, num_threads, feats_ptrs);
+      for (size_t i = 0; i < feats.size(); i++)
+        feat_writer.Write(utts[i], feats[i]);
+      num_done += feats.size();
+      utts.clear();
+      feats.clear();
+      if (!global) cmvn_stats.clear();
+    };
+
+    if (!global) { // reading from a Table: per-speaker or per-utt CMN/CVN.
+      std::string cmvn_rspecifier = cmvn_rspecifier_or_rxfilename;
+
+      RandomAccessDoubleMatrixReaderMapped cmvn_reader(cmvn_rspecifier,
+                                                       utt2spk_rspecifier);
+
+      for (; !feat_reader.Done(); feat_reader.Next()) {
+        std::string utt = feat_reader.Key();
+        if (!cmvn_reader.HasKey(utt)) {
+          KALDI_WARN << "No normalization statistics available for key "
+                     << utt << ", producing no output for this utterance";
+          num_err++;
+          continue;
+        }
+        // Deep copies (Matrix's implicit copy would share the storage the
+        // readers reuse).
+        const MatrixBase<double> &utt_stats = cmvn_reader.Value(utt);
+        const MatrixBase<BaseFloat> &utt_feats = feat_reader.Value();
+        cmvn_stats.emplace_back(utt_stats);
+        if (!skip_dims.empty())
+          FakeStatsForSomeDims(skip_dims, &cmvn_stats.back());
+        utts.push_back(utt);
+        feats.emplace_back(utt_feats);
+        if (static_cast<int32>(feats.size()) == batch_size)
+          process_batch();
+      }
+      process_batch();
+    } else {
+      if (utt2spk_rspecifier != "")
+        KALDI_ERR << "--utt2spk option not compatible with rxfilename as input "
+                  << "(did you forget ark:?)";
+      std::string cmvn_rxfilename = cmvn_rspecifier_or_rxfilename;
+      bool binary;
+      Input ki(cmvn_rxfilename, &binary);
+      cmvn_stats.resize(1);
+      cmvn_stats[0].Read(ki.Stream(), binary);
+      if (!skip_dims.empty())
+        FakeStatsForSomeDims(skip_dims, &cmvn_stats[0]);
+
+      for (;!feat_reader.Done(); feat_reader.Next()) {
+        const MatrixBase<BaseFloat> &utt_feats = feat_reader.Value();
+        utts.push_back(feat_reader.Key());
+        feats.emplace_back(utt_feats);
+        if (static_cast<int32>(feats.size()) == batch_size)
+          process_batch();
+      }
+      process_batch();
+    }
+    if (norm_vars)
+      KALDI_LOG << "Applied cepstral mean and variance normalization to "
+                << num_done << " utterances, errors on " << num_err;
+    else
+      KALDI_LOG << "Applied cepstral mean normalization to "
+                << num_done << " utterances, errors on " << num_err;
+    return (num_done != 0 ? 0 : 1);
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
@@ -0,0 +1,247 @@
+// featbin/compute-cmvn-stats.cc
+
+// Copyright 2009-2011  Microsoft Corporation
+
+// See https://github.com/kaldi-asr/kaldi/blob/7fb716aa0f56480af31514c7e362db5c9f787fd4/COPYING
+// for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+// Based on https://github.com/kaldi-asr/kaldi/blob/7fb716aa0f56480af31514c7e362db5c9f787fd4/src/featbin/compute-cmvn-stats.cc
+//
+// Unlike the original, the utterances (or speakers) of a batch are processed
+// in parallel with --num-threads threads, and the features can also be read
+// from NumPy files (see util/npy-table.h). The output is the same.
+
+#include <memory>
+#include <vector>
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "matrix/kaldi-matrix.h"
+#include "transform/cmvn.h"
+#include "util/npy-table.h"
+
+namespace kaldi {
+
+// Looks up the weights of `utt`, if --weights was given. Returns false (after
+// warning) if they are needed but not usable.
+bool GetCmvnWeights(const std::string &utt,
+                    const MatrixBase<BaseFloat> &feats,
+                    RandomAccessBaseFloatVectorReader *weights_reader,
+                    std::unique_ptr<Vector<BaseFloat> > *weights) {
+  weights->reset();
+  if (!weights_reader->IsOpen())
+    return true;
+  if (!weights_reader->HasKey(utt)) {
+    KALDI_WARN << "No weights available for utterance " << utt;
+    return false;
+  }
+  const Vector<BaseFloat> &value = weights_reader->Value(utt);
+  if (value.Dim() != feats.NumRows()) {
+    KALDI_WARN << "Weights for utterance " << utt << " have wrong dimension "
+               << value.Dim() << " vs. " << feats.NumRows();
+    return false;
+  }
+  weights->reset(new Vector<BaseFloat>(value));
+  return true;
+}
+
+// The utterances of a batch, and the stats they are accumulated into.
+struct CmvnBatch {
+  std::vector<Matrix<BaseFloat> > feats;
+  std::vector<std::unique_ptr<Vector<BaseFloat> > > weights;
+  std::vector<int32> groups;
+  std::vector<std::string> group_keys;
+  std::vector<Matrix<double> > stats;
+
+  void Add(const MatrixBase<BaseFloat> &utt_feats,
+           std::unique_ptr<Vector<BaseFloat> > *utt_weights) {
+    feats.emplace_back(utt_feats);
+    weights.push_back(std::move(*utt_weights));
+    groups.push_back(stats.size() - 1);
+  }
+
+  void Accumulate(int32 num_threads) {
+    std::vector<const MatrixBase<BaseFloat>*> feats_ptrs;
+    std::vector<const VectorBase<BaseFloat>*> weights_ptrs;
+    for (size_t i = 0; i < feats.size(); i++) {
+      feats_ptrs.push_back(&feats[i]);
+      weights_ptrs.push_back(weights[i].get());
+    }
+    std::vector<MatrixBase<double>*> stats_ptrs;
+    for (auto &group_stats : stats)
+      stats_ptrs.push_back(&group_stats);
+    AccCmvnStatsBatch(feats_ptrs, weights_ptrs, groups, num_threads,
+                      stats_ptrs);
+  }
+
+  void Clear() {
+    feats.clear();
+    weights.clear();
+    groups.clear();
+    group_keys.clear();
+    stats.clear();
+  }
+};
+
+} // namespace kaldi
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+
+    const char *usage =
+        "Compute cepstral mean and variance normalization statistics\n"
+        "If wspecifier provided: per-utterance by default, or per-speaker if\n"
+        "spk2utt option provided; if wxfilename: global\n"
+        "Usage: compute-cmvn-stats  [options] <feats-rspecifier> (<stats-wspecifier>|<stats-wxfilename>)\n"
+        "e.g.: compute-cmvn-stats --spk2utt=ark:data/train/spk2utt"
+        " scp:data/train/feats.scp ark,scp:/foo/bar/cmvn.ark,data/train/cmvn.scp\n"
+        "<feats-rspecifier> can also be npz:<file> (a NumPy .npz archive) or\n"
+        "npy:<file> (a single .npy indexed by <file>.index)\n"
+        "See also: apply-cmvn\n";
+
+    ParseOptions po(usage);
+    std::string spk2utt_rspecifier, weights_rspecifier;
+    bool binary = true;
+    int32 num_threads = 1;
+    int32 batch_size = 256;
+    po.Register("spk2utt", &spk2utt_rspecifier, "rspecifier for speaker to "
+                "utterance-list map");
+    po.Register("binary", &binary, "write in binary mode (applies only to global CMN/CVN)");
+    po.Register("weights", &weights_rspecifier, "rspecifier for a vector of floats "
+                "for each utterance, that's a per-frame weight.");
+    po.Register("num-threads", &num_threads,
+                "Number of threads used to accumulate the statistics of "
+                "different utterances (or speakers).  The global statistics "
+                "are accumulated by a single thread.");
+    po.Register("batch-size", &batch_size,
+                "Number of utterances read and processed together (the "
+                "utterances of a speaker are always in the same batch).");
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 2) {
+      po.PrintUsage();
+      exit(1);
+    }
+    KALDI_ASSERT(batch_size > 0);
+
+    int32 num_done = 0, num_err = 0;
+    std::string rspecifier = po.GetArg(1);
+    std::string wspecifier_or_wxfilename = po.GetArg(2);
+
+    RandomAccessBaseFloatVectorReader weights_reader(weights_rspecifier);
+    CmvnBatch batch;
+    std::unique_ptr<Vector<BaseFloat> > weights;
+
+    if (ClassifyWspecifier(wspecifier_or_wxfilename, NULL, NULL, NULL)
+        != kNoWspecifier) { // writing to a Table: per-speaker or per-utt CMN/CVN.
+      std::string wspecifier = wspecifier_or_wxfilename;
+
+      DoubleMatrixWriter writer(wspecifier);
+
+      auto process_batch = [&]() {
+        batch.Accumulate(num_threads);
+        for (size_t g = 0; g < batch.stats.size(); g++) {
+          if (batch.stats[g].NumRows() == 0)
+            KALDI_WARN << "No stats accumulated for speaker " << batch.group_keys[g];
+          else
+            writer.Write(batch.group_keys[g], batch.stats[g]);
+        }
+        batch.Clear();
+      };
+
+      if (spk2utt_rspecifier != "") {
+        SequentialTokenVectorReader spk2utt_reader(spk2utt_rspecifier);
+        RandomAccessFeatureMatrixReader feat_reader(rspecifier);
+
+        for (; !spk2utt_reader.Done(); spk2utt_reader.Next()) {
+          std::string spk = spk2utt_reader.Key();
+          const std::vector<std::string> &uttlist = spk2utt_reader.Value();
+          batch.group_keys.push_back(spk);
+          batch.stats.emplace_back();
+          for (size_t i = 0; i < uttlist.size(); i++) {
+            std::string utt = uttlist[i];
+            if (!feat_reader.HasKey(utt)) {
+              KALDI_WARN << "Did not find features for utterance " << utt;
+              num_err++;
+              continue;
+            }
+            const Matrix<BaseFloat> &feats = feat_reader.Value(utt);
+            if (batch.stats.back().NumRows() == 0)
+              InitCmvnStats(feats.NumCols(), &batch.stats.back());
+            if (!GetCmvnWeights(utt, feats, &weights_reader, &weights)) {
+              num_err++;
+            } else {
+              batch.Add(feats, &weights);
+              num_done++;
+            }
+          }
+          if (static_cast<int32>(batch.feats.size()) >= batch_size)
+            process_batch();
+        }
+      } else {  // per-utterance normalization
+        SequentialFeatureMatrixReader feat_reader(rspecifier);
+        for (; !feat_reader.Done(); feat_reader.Next()) {
+          std::string utt = feat_reader.Key();
+          const Matrix<BaseFloat> &feats = feat_reader.Value();
+          if (!GetCmvnWeights(utt, feats, &weights_reader, &weights)) {
+            num_err++;
+            continue;
+          }
+          batch.group_keys.push_back(utt);
+          batch.stats.emplace_back();
+          InitCmvnStats(feats.NumCols(), &batch.stats.back());
+          batch.Add(feats, &weights);
+          num_done++;
+          if (static_cast<int32>(batch.feats.size()) >= batch_size)
+            process_batch();
+        }
+      }
+      process_batch();
+    } else { // accumulate global stats
+      if (spk2utt_rspecifier != "")
+        KALDI_ERR << "--spk2utt option not compatible with wxfilename as output "
+                   << "(did you forget ark:?)";
+      std::string wxfilename = wspecifier_or_wxfilename;
+      bool is_init = false;
+      Matrix<double> stats;
+      SequentialFeatureMatrixReader feat_reader(rspecifier);
+      for (; !feat_reader.Done(); feat_reader.Next()) {
+        std::string utt = feat_reader.Key();
+        const Matrix<BaseFloat> &feats = feat_reader.Value();
+        if (!is_init) {
+          InitCmvnStats(feats.NumCols(), &stats);
+          is_init = true;
+        }
+        if (!GetCmvnWeights(utt, feats, &weights_reader, &weights)) {
+          num_err++;
+        } else {
+          AccCmvnStats(feats, weights.get(), &stats);
+          num_done++;
+        }
+      }
+      WriteKaldiObject(stats, wxfilename, binary);
+      KALDI_LOG << "Wrote global CMVN stats to "
+                << PrintableWxfilename(wxfilename);
+    }
+    KALDI_LOG << "Done accumulating CMVN stats for " << num_done
+              << " utterances; " << num_err << " had errors.";
+    return (num_done != 0 ? 0 : 1);
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
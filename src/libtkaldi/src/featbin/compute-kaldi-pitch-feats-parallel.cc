@@ -0,0 +1,180 @@
+// featbin/compute-kaldi-pitch-feats-parallel.cc
+
+// Not in Kaldi.
+//
+// compute-kaldi-pitch-feats, processing the utterances of a batch in
+// parallel with a WorkStealingScheduler.
+
+#include <memory>
+#include <sstream>
+#include <vector>
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "feat/pitch-batch.h"
+#include "feat/pitch-cache.h"
+#include "feat/pitch-functions.h"
+#include "feat/wave-reader.h"
+#include "util/npy-table.h"
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    const char *usage =
+        "Apply Kaldi pitch extractor, starting from wav input, using multiple\n"
+        "threads.  The output is the same as compute-kaldi-pitch-feats, in the\n"
+        "same order, unless --max-chunk-length is set.\n"
+        "Usage: compute-kaldi-pitch-feats-parallel [options...] <wav-rspecifier> <feats-wspecifier>\n"
+        "e.g.\n"
+        "compute-kaldi-pitch-feats-parallel --num-threads=8 --sample-frequency=8000 scp:wav.scp ark:- \n"
+        "<feats-wspecifier> can also be npz:<file>, for a NumPy .npz archive, or\n"
+        "npy:<file>, for a single .npy of all the frames, indexed by <file>.index\n"
+        "\n"
+        "See also: compute-kaldi-pitch-feats\n";
+
+    ParseOptions po(usage);
+    PitchExtractionOptions pitch_opts;
+    PitchBatchOptions batch_opts;
+    int32 channel = -1;
+    int32 batch_size = 256;
+    std::string cache_dir;
+    int64 cache_max_bytes = 0;
+
+    pitch_opts.Register(&po);
+    batch_opts.Register(&po);
+    po.Register("channel", &channel,
+                "Channel to extract (-1 -> expect mono, 0 -> left, 1 -> right)");
+    po.Register("batch-size", &batch_size,
+                "Number of utterances read and processed together.  Larger "
+                "batches balance better across threads, but use more memory.");
+    po.Register("cache-dir", &cache_dir,
+                "If set, features are cached in this directory, keyed by the "
+                "content of the wave and the options, and read from it when "
+                "the same wave is processed again.");
+    po.Register("cache-max-bytes", &cache_max_bytes,
+                "If > 0, the least recently used entries of --cache-dir are "
+                "removed to keep its size under this many bytes.");
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 2) {
+      po.PrintUsage();
+      exit(1);
+    }
+    KALDI_ASSERT(batch_size > 0);
+
+    std::string wav_rspecifier = po.GetArg(1),
+        feat_wspecifier = po.GetArg(2);
+
+    SequentialTableReader<WaveHolder> wav_reader(wav_rspecifier);
+    FeatureMatrixWriter feat_writer(feat_wspecifier);
+
+    int32 num_done = 0, num_err = 0;
+    std::vector<std::string> utts;
+    // Owned copies; the reader reuses the memory of the wave data.
+    std::vector<Vector<BaseFloat> > waveforms;
+    waveforms.reserve(batch_size);
+
+    std::unique_ptr<FeatureCache> cache;
+    std::ostringstream options_string;
+    options_string << PitchOptionsString(pitch_opts);
+    // Chunking changes the result.
+    if (batch_opts.max_chunk_length > 0.0)
+      options_string << " max_chunk_length=" << batch_opts.max_chunk_length
+                     << " chunk_overlap=" << batch_opts.chunk_overlap;
+    if (!cache_dir.empty())
+      cache.reset(new FeatureCache(cache_dir, cache_max_bytes));
+
+    auto process_batch = [&]() {
+      std::vector<Matrix<BaseFloat> > features(utts.size());
+      std::vector<std::string> keys(utts.size());
+      // The indexes of the utterances which are not in the cache.
+      std::vector<size_t> todo;
+      for (size_t i = 0; i < utts.size(); i++) {
+        if (cache) {
+          keys[i] = FeatureCache::Key(waveforms[i], options_string.str());
+          if (cache->Lookup(keys[i], &features[i]))
+            continue;
+        }
+        todo.push_back(i);
+      }
+      std::vector<const VectorBase<BaseFloat>*> inputs;
+      for (size_t i : todo)
+        inputs.push_back(&waveforms[i]);
+      std::vector<Matrix<BaseFloat> > computed;
+      std::vector<bool> succeeded(utts.size(), true), computed_ok;
+      SchedulerStats stats;
+      ComputeKaldiPitchBatch(pitch_opts, batch_opts, inputs, &computed,
+                             &computed_ok, &stats);
+      KALDI_VLOG(1) << "Batch of " << utts.size() << " utterances, "
+                    << todo.size() << " computed:\n" << stats.ToString();
+      for (size_t j = 0; j < todo.size(); j++) {
+        const size_t i = todo[j];
+        succeeded[i] = computed_ok[j];
+        features[i].Swap(&computed[j]);
+        if (cache && succeeded[i])
+          cache->Insert(keys[i], features[i]);
+      }
+      for (size_t i = 0; i < utts.size(); i++) {
+        if (!succeeded[i]) {
+          KALDI_WARN << "Failed to compute pitch for utterance " << utts[i];
+          num_err++;
+          continue;
+        }
+        feat_writer.Write(utts[i], features[i]);
+        num_done++;
+      }
+      utts.clear();
+      waveforms.clear();
+    };
+
+    for (; !wav_reader.Done(); wav_reader.Next()) {
+      std::string utt = wav_reader.Key();
+      const WaveData &wave_data = wav_reader.Value();
+
+      int32 num_chan = wave_data.Data().NumRows(), this_chan = channel;
+      {
+        KALDI_ASSERT(num_chan > 0);
+        if (channel == -1) {
+          this_chan = 0;
+          if (num_chan != 1)
+            KALDI_WARN << "Channel not specified but you have data with "
+                       << num_chan  << " channels; defaulting to zero";
+        } else {
+          if (this_chan >= num_chan) {
+            KALDI_WARN << "File with id " << utt << " has "
+                       << num_chan << " channels but you specified channel "
+                       << channel << ", producing no output.";
+            continue;
+          }
+        }
+      }
+
+      if (pitch_opts.samp_freq != wave_data.SampFreq())
+        KALDI_ERR << "Sample frequency mismatch: you specified "
+                  << pitch_opts.samp_freq << " but data has "
+                  << wave_data.SampFreq() << " (use --sample-frequency "
+                  << "option).  Utterance is " << utt;
+
+      utts.push_back(utt);
+      waveforms.emplace_back(SubVector<BaseFloat>(wave_data.Data(), this_chan));
+      if (static_cast<int32>(utts.size()) == batch_size)
+        process_batch();
+    }
+    if (!utts.empty())
+      process_batch();
+
+    if (cache) {
+      FeatureCacheStats stats = cache->Stats();
+      KALDI_LOG << "Cache: " << stats.num_hits << " hits, " << stats.num_misses
+                << " misses, " << stats.bytes_saved << " bytes read, "
+                << stats.bytes_written << " bytes written, "
+                << stats.num_evictions << " entries evicted.";
+    }
+    KALDI_LOG << "Done " << num_done << " utterances, " << num_err
+              << " with errors.";
+    return (num_done != 0 ? 0 : 1);
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
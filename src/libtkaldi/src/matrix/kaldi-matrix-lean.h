@@ -0,0 +1,351 @@
+// matrix/kaldi-matrix-lean.h
+
+// Not in Kaldi.
+//
+// The storage of MatrixBase / Matrix / SubMatrix when KALDI_LEAN_STORAGE is
+// defined; included by matrix/kaldi-matrix.h in place of the torch::Tensor
+// backend, with the same methods. See matrix/kaldi-vector-lean.h.
+//
+// As with the tensor backend, the rows of a Matrix are not padded (its
+// stride is its number of columns, whatever the MatrixStrideType), and a
+// Matrix copied implicitly shares the storage of the original.
+
+#ifndef KALDI_MATRIX_KALDI_MATRIX_LEAN_H_
+#define KALDI_MATRIX_KALDI_MATRIX_LEAN_H_
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <ostream>
+#include "matrix/matrix-common.h"
+#include "matrix/kaldi-vector.h"
+
+namespace kaldi {
+
+template<typename Real>
+struct MatrixBase {
+  inline MatrixIndexT NumRows() const { return num_rows_; };
+
+  inline MatrixIndexT NumCols() const { return num_cols_; };
+
+  inline MatrixIndexT Stride() const {  return stride_; }
+
+  inline const Real* Data() const { return data_; }
+
+  inline Real* Data() { return data_; }
+
+  inline  Real* RowData(MatrixIndexT i) {
+    KALDI_PARANOID_ASSERT(static_cast<UnsignedMatrixIndexT>(i) <
+                          static_cast<UnsignedMatrixIndexT>(num_rows_));
+    return data_ + static_cast<size_t>(i) * stride_;
+  }
+
+  inline const Real* RowData(MatrixIndexT i) const {
+    KALDI_PARANOID_ASSERT(static_cast<UnsignedMatrixIndexT>(i) <
+                          static_cast<UnsignedMatrixIndexT>(num_rows_));
+    return data_ + static_cast<size_t>(i) * stride_;
+  }
+
+  /// Not in Kaldi. Always true with this storage.
+  bool HasContiguousRows() const { return true; }
+
+  void CopyColFromVec(const VectorBase<Real> &v, const MatrixIndexT col) {
+    KALDI_ASSERT(v.Dim() == num_rows_ &&
+                 static_cast<UnsignedMatrixIndexT>(col) <
+                 static_cast<UnsignedMatrixIndexT>(num_cols_));
+    const Real *src = v.Data();
+    for (MatrixIndexT r = 0; r < num_rows_; r++)
+      RowData(r)[col] = src[r];
+  }
+
+  inline Real&  operator() (MatrixIndexT r, MatrixIndexT c) {
+    KALDI_PARANOID_ASSERT(static_cast<UnsignedMatrixIndexT>(c) <
+                          static_cast<UnsignedMatrixIndexT>(num_cols_));
+    return RowData(r)[c];
+  }
+
+  inline const Real operator() (MatrixIndexT r, MatrixIndexT c) const {
+    KALDI_PARANOID_ASSERT(static_cast<UnsignedMatrixIndexT>(c) <
+                          static_cast<UnsignedMatrixIndexT>(num_cols_));
+    return RowData(r)[c];
+  }
+
+  void SetZero() {
+    for (MatrixIndexT r = 0; r < num_rows_; r++)
+      std::fill(RowData(r), RowData(r) + num_cols_, Real(0));
+  }
+
+  template<typename OtherReal>
+  void CopyFromMat(const MatrixBase<OtherReal> & M,
+                   MatrixTransposeType trans = kNoTrans) {
+    if (trans == kNoTrans) {
+      KALDI_ASSERT(num_rows_ == M.NumRows() && num_cols_ == M.NumCols());
+      for (MatrixIndexT r = 0; r < num_rows_; r++) {
+        const OtherReal *src = M.RowData(r);
+        Real *dst = RowData(r);
+        if (static_cast<const void*>(src) != static_cast<void*>(dst))
+          std::copy(src, src + num_cols_, dst);
+      }
+    } else {
+      KALDI_ASSERT(num_rows_ == M.NumCols() && num_cols_ == M.NumRows());
+      for (MatrixIndexT r = 0; r < num_rows_; r++) {
+        Real *dst = RowData(r);
+        for (MatrixIndexT c = 0; c < num_cols_; c++)
+          dst[c] = M.RowData(c)[r];
+      }
+    }
+  }
+
+  inline const SubVector<Real> Row(MatrixIndexT i) const {
+    return SubVector<Real>(*this, i);
+  }
+
+  inline SubMatrix<Real> Range(const MatrixIndexT row_offset,
+                               const MatrixIndexT num_rows,
+                               const MatrixIndexT col_offset,
+                               const MatrixIndexT num_cols) const {
+    return SubMatrix<Real>(*this, row_offset, num_rows,
+                           col_offset, num_cols);
+  }
+
+  inline SubMatrix<Real> RowRange(const MatrixIndexT row_offset,
+                                  const MatrixIndexT num_rows) const {
+    return SubMatrix<Real>(*this, row_offset, num_rows, 0, NumCols());
+  }
+
+  Real Max() const {
+    KALDI_ASSERT(num_rows_ > 0 && num_cols_ > 0);
+    Real ans = -std::numeric_limits<Real>::infinity();
+    for (MatrixIndexT r = 0; r < num_rows_; r++)
+      ans = std::max(ans, *std::max_element(RowData(r), RowData(r) + num_cols_));
+    return ans;
+  }
+
+  Real Min() const {
+    KALDI_ASSERT(num_rows_ > 0 && num_cols_ > 0);
+    Real ans = std::numeric_limits<Real>::infinity();
+    for (MatrixIndexT r = 0; r < num_rows_; r++)
+      ans = std::min(ans, *std::min_element(RowData(r), RowData(r) + num_cols_));
+    return ans;
+  }
+
+  void Scale(Real alpha) {
+    for (MatrixIndexT r = 0; r < num_rows_; r++) {
+      Real *row = RowData(r);
+      for (MatrixIndexT c = 0; c < num_cols_; c++)
+        row[c] *= alpha;
+    }
+  }
+
+  void AddMat(const Real alpha, const MatrixBase<Real> &M,
+              MatrixTransposeType transA = kNoTrans) {
+    if (transA == kNoTrans) {
+      KALDI_ASSERT(num_rows_ == M.num_rows_ && num_cols_ == M.num_cols_);
+      for (MatrixIndexT r = 0; r < num_rows_; r++) {
+        const Real *src = M.RowData(r);
+        Real *dst = RowData(r);
+        for (MatrixIndexT c = 0; c < num_cols_; c++)
+          dst[c] += alpha * src[c];
+      }
+    } else {
+      KALDI_ASSERT(num_rows_ == M.num_cols_ && num_cols_ == M.num_rows_);
+      for (MatrixIndexT r = 0; r < num_rows_; r++) {
+        Real *dst = RowData(r);
+        for (MatrixIndexT c = 0; c < num_cols_; c++)
+          dst[c] += alpha * M.RowData(c)[r];
+      }
+    }
+  }
+
+  void Read(std::istream & in, bool binary, bool add = false);
+
+  void Write(std::ostream & out, bool binary) const;
+
+protected:
+  explicit MatrixBase()
+      : data_(NULL), num_rows_(0), num_cols_(0), stride_(0), capacity_(0) {
+    KALDI_ASSERT_IS_FLOATING_TYPE(Real);
+  }
+
+  friend struct SubVector<Real>;
+  friend struct SubMatrix<Real>;
+
+  // As in VectorBase.
+  std::shared_ptr<void> storage_;
+  Real *data_;
+  MatrixIndexT num_rows_;
+  MatrixIndexT num_cols_;
+  MatrixIndexT stride_;
+  // Number of elements of storage_ from data_ on; only used by Matrix.
+  size_t capacity_;
+};
+
+template<typename Real>
+struct Matrix : MatrixBase<Real> {
+  Matrix() : MatrixBase<Real>() {}
+
+  Matrix(const MatrixIndexT r, const MatrixIndexT c,
+         MatrixResizeType resize_type = kSetZero,
+         MatrixStrideType stride_type = kDefaultStride)
+    : MatrixBase<Real>() { Resize(r, c, resize_type, stride_type); }
+
+  void Swap(Matrix<Real> *other) {
+    std::swap(this->storage_, other->storage_);
+    std::swap(this->data_, other->data_);
+    std::swap(this->num_rows_, other->num_rows_);
+    std::swap(this->num_cols_, other->num_cols_);
+    std::swap(this->stride_, other->stride_);
+    std::swap(this->capacity_, other->capacity_);
+  }
+
+  // Note: like Vector's copy constructors, this always owns a contiguous copy.
+  explicit Matrix(const MatrixBase<Real> & M,
+                  MatrixTransposeType trans = kNoTrans) : MatrixBase<Real>() {
+    if (trans == kNoTrans)
+      Resize(M.NumRows(), M.NumCols(), kUndefined);
+    else
+      Resize(M.NumCols(), M.NumRows(), kUndefined);
+    this->CopyFromMat(M, trans);
+  }
+
+  template<typename OtherReal>
+  explicit Matrix(const MatrixBase<OtherReal> & M,
+                  MatrixTransposeType trans = kNoTrans) : MatrixBase<Real>() {
+    if (trans == kNoTrans)
+      Resize(M.NumRows(), M.NumCols(), kUndefined);
+    else
+      Resize(M.NumCols(), M.NumRows(), kUndefined);
+    this->CopyFromMat(M, trans);
+  }
+
+  explicit Matrix(const CompressedMatrix &C);
+
+  void Read(std::istream & in, bool binary, bool add = false);
+
+  void Resize(const MatrixIndexT r,
+              const MatrixIndexT c,
+              MatrixResizeType resize_type = kSetZero,
+              MatrixStrideType stride_type = kDefaultStride) {
+    KALDI_ASSERT(r >= 0 && c >= 0);
+    GetResizeStats().num_resizes++;
+    const size_t size = static_cast<size_t>(r) * c;
+    if (resize_type == kCopyData && c != this->num_cols_) {
+      // The rows move, so the kept part goes to new storage.
+      Matrix<Real> old;
+      Swap(&old);
+      Allocate(size, 0);
+      SetShape(r, c);
+      this->SetZero();
+      const MatrixIndexT rows = std::min(r, old.num_rows_),
+        cols = std::min(c, old.num_cols_);
+      for (MatrixIndexT i = 0; i < rows; i++)
+        std::copy(old.RowData(i), old.RowData(i) + cols, this->RowData(i));
+      return;
+    }
+    // Otherwise the kept rows stay in place unless the storage has to grow.
+    const MatrixIndexT rows =
+      resize_type == kCopyData ? std::min(r, this->num_rows_) : 0;
+    if (size > this->capacity_)
+      Allocate(size, static_cast<size_t>(rows) * c);
+    SetShape(r, c);
+    if (resize_type == kSetZero)
+      this->SetZero();
+    else if (resize_type == kCopyData)
+      // Only the newly exposed rows need zeroing.
+      std::fill(this->data_ + static_cast<size_t>(rows) * c,
+                this->data_ + size, Real(0));
+  }
+
+  /// Not in Kaldi. Makes the following Resize calls up to
+  /// `num_rows` x `num_cols` elements allocation-free.
+  void Reserve(const MatrixIndexT num_rows, const MatrixIndexT num_cols) {
+    const size_t capacity = static_cast<size_t>(num_rows) * num_cols;
+    if (capacity > this->capacity_)
+      Allocate(capacity,
+               static_cast<size_t>(this->num_rows_) * this->num_cols_);
+  }
+
+  /// Not in Kaldi. Same as Reserve(): without libtorch, there is no process
+  /// to hand the result to.
+  void ReserveShared(const MatrixIndexT num_rows, const MatrixIndexT num_cols) {
+    Reserve(num_rows, num_cols);
+  }
+
+  /// Not in Kaldi. Makes this matrix a view of the `num_rows` x `num_cols`
+  /// matrix with contiguous rows at `data` (e.g. in a mapped file), without
+  /// copying it. `owner` is kept until the storage is released, so it can
+  /// free the memory (e.g. unmap the file) when it is destroyed.
+  void SetExternalData(Real *data, MatrixIndexT num_rows, MatrixIndexT num_cols,
+                       std::shared_ptr<void> owner) {
+    this->storage_ = owner;
+    this->data_ = data;
+    this->capacity_ = static_cast<size_t>(num_rows) * num_cols;
+    SetShape(num_rows, num_cols);
+  }
+
+  Matrix<Real> &operator = (const MatrixBase<Real> &other) {
+    if (MatrixBase<Real>::NumRows() != other.NumRows() ||
+        MatrixBase<Real>::NumCols() != other.NumCols())
+      Resize(other.NumRows(), other.NumCols(), kUndefined);
+    MatrixBase<Real>::CopyFromMat(other);
+    return *this;
+  }
+
+ private:
+  void SetShape(MatrixIndexT num_rows, MatrixIndexT num_cols) {
+    this->num_rows_ = num_rows;
+    this->num_cols_ = num_cols;
+    this->stride_ = num_cols;
+  }
+
+  // Replaces the storage by new storage of `capacity` elements, which holds
+  // the first `num_kept` elements of the current one.
+  void Allocate(size_t capacity, size_t num_kept) {
+    std::shared_ptr<void> storage =
+      internal::AllocateStorage(sizeof(Real) * capacity);
+    Real *data = static_cast<Real*>(storage.get());
+    if (num_kept) std::copy(this->data_, this->data_ + num_kept, data);
+    this->storage_ = storage;
+    this->data_ = data;
+    this->capacity_ = capacity;
+  }
+};
+
+template<typename Real>
+struct SubMatrix : MatrixBase<Real> {
+  SubMatrix(const MatrixBase<Real>& T,
+            const MatrixIndexT ro,  // row offset, 0 < ro < NumRows()
+            const MatrixIndexT r,   // number of rows, r > 0
+            const MatrixIndexT co,  // column offset, 0 < co < NumCols()
+            const MatrixIndexT c)   // number of columns, c > 0
+      : MatrixBase<Real>() {
+    KALDI_ASSERT(ro >= 0 && r >= 0 && ro + r <= T.num_rows_ &&
+                 co >= 0 && c >= 0 && co + c <= T.num_cols_);
+    this->storage_ = T.storage_;
+    this->data_ = T.data_ + static_cast<size_t>(ro) * T.stride_ + co;
+    this->num_rows_ = r;
+    this->num_cols_ = c;
+    this->stride_ = T.stride_;
+  }
+
+  SubMatrix(Real *data,
+            MatrixIndexT num_rows,
+            MatrixIndexT num_cols,
+            MatrixIndexT stride)
+      : MatrixBase<Real>() {
+    this->data_ = data;
+    this->num_rows_ = num_rows;
+    this->num_cols_ = num_cols;
+    this->stride_ = stride;
+  }
+};
+
+template<typename Real>
+std::ostream & operator << (std::ostream & Out, const MatrixBase<Real> & M) {
+  M.Write(Out, false);
+  return Out;
+}
+
+} // namespace kaldi
+
+#endif
@@ -27,6 +27,7 @@
 #include "matrix/kaldi-matrix.h"
 #include "matrix/compressed-matrix.h"
 
+#ifndef KALDI_LEAN_STORAGE
 namespace {
 
 template<typename Real>
@@ -45,13 +46,16 @@ void assert_matrix_shape<double>(const torch::Tensor &tensor_) {
 }
 
 } // namespace
+#endif
 
 namespace kaldi {
 
+#ifndef KALDI_LEAN_STORAGE
 template<typename Real>
 MatrixBase<Real>::MatrixBase(torch::Tensor tensor) : tensor_(tensor) {
   assert_matrix_shape<Real>(tensor_);
 };
+#endif
 
 // https://github.com/kaldi-asr/kaldi/blob/7fb716aa0f56480af31514c7e362db5c9f787fd4/src/matrix/kaldi-matrix.cc#L1377-L1418
 template<typename Real>
@@ -159,12 +163,34 @@ void Matrix<Real>::Read(std::istream & is, bool binary, bool add) {
     }
     const char *my_token =  (sizeof(Real) == 4 ? "FM" : "DM");
     char other_token_start = (sizeof(Real) == 4 ? 'D' : 'F');
-    if (peekval == other_token_start) {  // need to instantiate the other type to read it.
+    if (peekval == other_token_start) {
+      // Not in Kaldi: instead of reading into a Matrix of the other type and
+      // copying it, the rows are read one at a time and converted in place.
       typedef typename OtherReal<Real>::Real OtherType;  // if Real == float, OtherType == double, and vice versa.
-      Matrix<OtherType> other(this->NumRows(), this->NumCols());
-      other.Read(is, binary, false);  // add is false at this point anyway.
-      this->Resize(other.NumRows(), other.NumCols());
-      this->CopyFromMat(other);
+      const char *other_token = (sizeof(Real) == 4 ? "DM" : "FM");
+      std::string token;
+      ReadToken(is, binary, &token);
+      if (token != other_token) {
+        if (token.length() > 20) token = token.substr(0, 17) + "...";
+        specific_error << ": Expected token " << other_token << ", got " << token;
+        goto bad;
+      }
+      int32 rows, cols;
+      ReadBasicType(is, binary, &rows);  // throws on error.
+      ReadBasicType(is, binary, &cols);  // throws on error.
+      if ((MatrixIndexT)rows != this->NumRows() || (MatrixIndexT)cols != this->NumCols()) {
+        this->Resize(rows, cols, kUndefined);
+      }
+      std::vector<OtherType> row_buffer(cols);
+      for (MatrixIndexT i = 0; i < (MatrixIndexT)rows; i++) {
+        is.read(reinterpret_cast<char*>(row_buffer.data()), sizeof(OtherType)*cols);
+        if (is.fail()) goto bad;
+        Real *row = this->Data() + static_cast<size_t>(i) * this->Stride();
+        for (MatrixIndexT j = 0; j < (MatrixIndexT)cols; j++)
+          row[j] = static_cast<Real>(row_buffer[j]);
+      }
+      if (is.eof()) return;
+      if (is.fail()) goto bad;
       return;
     }
     std::string token;
@@ -26,10 +26,16 @@
 #ifndef KALDI_MATRIX_KALDI_MATRIX_H_
 #define KALDI_MATRIX_KALDI_MATRIX_H_
 
-#include <torch/torch.h>
 #include "matrix/matrix-common.h"
 #include "matrix/kaldi-vector.h"
 
+// Not in Kaldi. See the storage selection in matrix/kaldi-vector.h.
+#ifdef KALDI_LEAN_STORAGE
+#include "matrix/kaldi-matrix-lean.h"
+#else
+
+#include <torch/torch.h>
+
 using namespace torch::indexing;
 
 namespace kaldi {
@@ -68,6 +74,12 @@ struct MatrixBase {
   // https://github.com/kaldi-asr/kaldi/blob/7fb716aa0f56480af31514c7e362db5c9f787fd4/src/matrix/kaldi-matrix.h#L92-L97
   inline const Real* RowData(MatrixIndexT i) const { return tensor_.index({i}).data_ptr<Real>(); }
 
+  /// Not in Kaldi. Whether the elements of each row are adjacent in memory,
+  /// as Kaldi assumes; a MatrixBase can view a transposed tensor.
+  bool HasContiguousRows() const {
+    return NumCols() <= 1 || tensor_.stride(1) == 1;
+  }
+
   // https://github.com/kaldi-asr/kaldi/blob/7fb716aa0f56480af31514c7e362db5c9f787fd4/src/matrix/kaldi-matrix.h#L177-L178
   void CopyColFromVec(const VectorBase<Real> &v, const MatrixIndexT col) {
     tensor_.index_put_({Slice(), col}, v.tensor_);
@@ -142,7 +154,8 @@ struct MatrixBase {
 protected:
 
   // https://github.com/kaldi-asr/kaldi/blob/7fb716aa0f56480af31514c7e362db5c9f787fd4/src/matrix/kaldi-matrix.h#L749-L753
-  explicit MatrixBase(): tensor_(torch::empty({0, 0})) {
+  explicit MatrixBase()
+      : tensor_(torch::empty({0, 0}, c10::CppTypeToScalarType<Real>::value)) {
     KALDI_ASSERT_IS_FLOATING_TYPE(Real);
   }
 };
@@ -167,16 +180,21 @@ struct Matrix : MatrixBase<Real> {
   }
 
   // https://github.com/kaldi-asr/kaldi/blob/7fb716aa0f56480af31514c7e362db5c9f787fd4/src/matrix/kaldi-matrix.h#L808-L811
+  // Note: like Vector's copy constructors, this always owns a contiguous copy.
   explicit Matrix(const MatrixBase<Real> & M,
                   MatrixTransposeType trans = kNoTrans)
-    : MatrixBase<Real>(trans == kNoTrans ? M.tensor_ : M.tensor_.transpose(1, 0))
+    : MatrixBase<Real>((trans == kNoTrans ? M.tensor_ : M.tensor_.transpose(1, 0))
+                       .clone(at::MemoryFormat::Contiguous))
     {}
 
   // https://github.com/kaldi-asr/kaldi/blob/7fb716aa0f56480af31514c7e362db5c9f787fd4/src/matrix/kaldi-matrix.h#L816-L819
   template<typename OtherReal>
   explicit Matrix(const MatrixBase<OtherReal> & M,
                   MatrixTransposeType trans = kNoTrans)
-    : MatrixBase<Real>(trans == kNoTrans ? M.tensor_ : M.tensor_.transpose(1, 0))
+    : MatrixBase<Real>((trans == kNoTrans ? M.tensor_ : M.tensor_.transpose(1, 0))
+                       .to(c10::CppTypeToScalarType<Real>::value,
+                           /*non_blocking=*/false, /*copy=*/true,
+                           at::MemoryFormat::Contiguous))
     {}
 
   // https://github.com/kaldi-asr/kaldi/blob/7fb716aa0f56480af31514c7e362db5c9f787fd4/src/matrix/kaldi-matrix.h#L829-L830
@@ -194,23 +212,64 @@ struct Matrix : MatrixBase<Real> {
     auto &tensor_ = MatrixBase<Real>::tensor_;
     switch(resize_type) {
     case kSetZero:
-      tensor_.resize_({r, c}).zero_();
+      internal::ResizeTensor(&tensor_, {r, c});
+      tensor_.zero_();
       break;
     case kUndefined:
-      tensor_.resize_({r, c});
+      internal::ResizeTensor(&tensor_, {r, c});
       break;
     case kCopyData:
-      auto tmp = tensor_;
-      auto tmp_rows = tmp.size(0);
-      auto tmp_cols = tmp.size(1);
-      tensor_.resize_({r, c}).zero_();
-      auto rows = Slice(None, r < tmp_rows ? r : tmp_rows);
-      auto cols = Slice(None, c < tmp_cols ? c : tmp_cols);
-      tensor_.index_put_({rows, cols}, tmp.index({rows, cols}));
+      auto old = tensor_;
+      auto rows = std::min<MatrixIndexT>(r, old.size(0));
+      auto cols = std::min<MatrixIndexT>(c, old.size(1));
+      if (c == old.size(1) && old.is_contiguous()) {
+        // The row layout does not change, so the kept rows stay in place
+        // unless the storage has to grow.
+        if (internal::ResizeTensor(&tensor_, {r, c}) && rows) {
+          tensor_.narrow(0, 0, rows).copy_(old.narrow(0, 0, rows));
+        }
+      } else {
+        tensor_ = internal::AllocateTensor({r, c}, old.options());
+        if (rows && cols) {
+          tensor_.narrow(0, 0, rows).narrow(1, 0, cols).copy_(
+            old.narrow(0, 0, rows).narrow(1, 0, cols));
+        }
+        if (c > cols) {
+          tensor_.narrow(0, 0, rows).narrow(1, cols, c - cols).zero_();
+        }
+      }
+      // Only the newly exposed rows need zeroing.
+      if (r > rows) {
+        tensor_.narrow(0, rows, r - rows).zero_();
+      }
       break;
     }
   }
 
+  /// Not in Kaldi. Makes the following Resize calls up to
+  /// `num_rows` x `num_cols` elements allocation-free.
+  void Reserve(const MatrixIndexT num_rows, const MatrixIndexT num_cols) {
+    internal::ReserveTensor(&(this->tensor_), num_rows * num_cols);
+  }
+
+  /// Not in Kaldi. Same as Reserve(), with the storage in shared memory, so
+  /// that the result can be handed to another process without a copy as
+  /// long as it fits in `num_rows` x `num_cols` elements.
+  void ReserveShared(const MatrixIndexT num_rows, const MatrixIndexT num_cols) {
+    internal::ReserveTensor(&(this->tensor_), num_rows * num_cols, true);
+  }
+
+  /// Not in Kaldi. Makes this matrix a view of the `num_rows` x `num_cols`
+  /// matrix with contiguous rows at `data` (e.g. in a mapped file), without
+  /// copying it. `owner` is kept until the storage is released, so it can
+  /// free the memory (e.g. unmap the file) when it is destroyed.
+  void SetExternalData(Real *data, MatrixIndexT num_rows, MatrixIndexT num_cols,
+                       std::shared_ptr<void> owner) {
+    this->tensor_ = torch::from_blob(
+      data, {num_rows, num_cols}, [owner](void*) {},
+      torch::TensorOptions().dtype(c10::CppTypeToScalarType<Real>::value));
+  }
+
   // https://github.com/kaldi-asr/kaldi/blob/7fb716aa0f56480af31514c7e362db5c9f787fd4/src/matrix/kaldi-matrix.h#L876-L883
   Matrix<Real> &operator = (const MatrixBase<Real> &other) {
     if (MatrixBase<Real>::NumRows() != other.NumRows() ||
@@ -221,26 +280,6 @@ struct Matrix : MatrixBase<Real> {
   }
 };
 
-// https://github.com/kaldi-asr/kaldi/blob/7fb716aa0f56480af31514c7e362db5c9f787fd4/src/matrix/kaldi-matrix.h#L913-L924
-struct HtkHeader {
-  /// Number of samples.
-  int32    mNSamples;
-  /// Sample period.
-  int32    mSamplePeriod;
-  /// Sample size
-  int16    mSampleSize;
-  /// Sample kind.
-  uint16   mSampleKind;
-};
-
-// https://github.com/kaldi-asr/kaldi/blob/7fb716aa0f56480af31514c7e362db5c9f787fd4/src/matrix/kaldi-matrix.h#L926-L928
-template<typename Real>
-bool ReadHtk(std::istream &is, Matrix<Real> *M, HtkHeader *header_ptr);
-
-// https://github.com/kaldi-asr/kaldi/blob/7fb716aa0f56480af31514c7e362db5c9f787fd4/src/matrix/kaldi-matrix.h#L930-L932
-template<typename Real>
-bool WriteHtk(std::ostream &os, const MatrixBase<Real> &M, HtkHeader htk_hdr);
- 
 // https://github.com/kaldi-asr/kaldi/blob/7fb716aa0f56480af31514c7e362db5c9f787fd4/src/matrix/kaldi-matrix.h#L940-L948
 template<typename Real>
 struct SubMatrix : MatrixBase<Real> {
@@ -271,4 +310,30 @@ std::ostream & operator << (std::ostream & Out, const MatrixBase<Real> & M) {
   
 } // namespace kaldi
 
+#endif  // KALDI_LEAN_STORAGE
+
+namespace kaldi {
+
+// https://github.com/kaldi-asr/kaldi/blob/7fb716aa0f56480af31514c7e362db5c9f787fd4/src/matrix/kaldi-matrix.h#L913-L924
+struct HtkHeader {
+  /// Number of samples.
+  int32    mNSamples;
+  /// Sample period.
+  int32    mSamplePeriod;
+  /// Sample size
+  int16    mSampleSize;
+  /// Sample kind.
+  uint16   mSampleKind;
+};
+
+// https://github.com/kaldi-asr/kaldi/blob/7fb716aa0f56480af31514c7e362db5c9f787fd4/src/matrix/kaldi-matrix.h#L926-L928
+template<typename Real>
+bool ReadHtk(std::istream &is, Matrix<Real> *M, HtkHeader *header_ptr);
+
+// https://github.com/kaldi-asr/kaldi/blob/7fb716aa0f56480af31514c7e362db5c9f787fd4/src/matrix/kaldi-matrix.h#L930-L932
+template<typename Real>
+bool WriteHtk(std::ostream &os, const MatrixBase<Real> &M, HtkHeader htk_hdr);
+
+} // namespace kaldi
+
 #endif
@@ -0,0 +1,410 @@
+// matrix/kaldi-vector-lean.h
+
+// Not in Kaldi.
+//
+// The storage of VectorBase / Vector / SubVector when KALDI_LEAN_STORAGE is
+// defined; included by matrix/kaldi-vector.h in place of the torch::Tensor
+// backend, with the same methods (see there for the corresponding Kaldi
+// methods), so that code using the shim compiles against either.
+//
+// The elements are held in a buffer aligned to kStorageAlignment bytes and
+// shared, like the storage of a tensor, by the Vector which allocated it and
+// the SubVectors viewing it, so that a view stays valid when the Vector is
+// resized or destroyed. The kernels are plain loops; the sums use several
+// partial sums, like the vectorized BLAS / ATen kernels, which lets the
+// compiler vectorize them without reassociating floating-point additions.
+// The results therefore match those of the tensor backend up to rounding.
+
+#ifndef KALDI_MATRIX_KALDI_VECTOR_LEAN_H_
+#define KALDI_MATRIX_KALDI_VECTOR_LEAN_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <ostream>
+#include <vector>
+#include "matrix/matrix-common.h"
+
+namespace kaldi {
+
+namespace internal {
+
+/// Alignment of the storage allocated by Vector and Matrix, in bytes: a cache
+/// line, which is also the widest vector register (AVX-512).
+const size_t kStorageAlignment = 64;
+
+/// Allocates `num_bytes` of uninitialized storage aligned to
+/// kStorageAlignment, and records it in ResizeStats.
+std::shared_ptr<void> AllocateStorage(size_t num_bytes);
+
+const int kNumPartialSums = 8;
+
+template<typename Real>
+Real Sum(const Real *x, MatrixIndexT n) {
+  Real partial[kNumPartialSums] = {0};
+  MatrixIndexT i = 0;
+  for (; i + kNumPartialSums <= n; i += kNumPartialSums)
+    for (int j = 0; j < kNumPartialSums; j++)
+      partial[j] += x[i + j];
+  Real sum = 0;
+  for (int j = 0; j < kNumPartialSums; j++)
+    sum += partial[j];
+  for (; i < n; i++)
+    sum += x[i];
+  return sum;
+}
+
+template<typename Real>
+Real Dot(const Real *x, const Real *y, MatrixIndexT n) {
+  Real partial[kNumPartialSums] = {0};
+  MatrixIndexT i = 0;
+  for (; i + kNumPartialSums <= n; i += kNumPartialSums)
+    for (int j = 0; j < kNumPartialSums; j++)
+      partial[j] += x[i + j] * y[i + j];
+  Real sum = 0;
+  for (int j = 0; j < kNumPartialSums; j++)
+    sum += partial[j];
+  for (; i < n; i++)
+    sum += x[i] * y[i];
+  return sum;
+}
+
+} // namespace internal
+
+template<typename Real>
+struct VectorBase {
+  void SetZero() { std::fill(data_, data_ + dim_, Real(0)); }
+
+  void Set(Real f) { std::fill(data_, data_ + dim_, f); }
+
+  inline MatrixIndexT Dim() const { return dim_; }
+
+  inline Real* Data() { return data_; }
+
+  inline const Real* Data() const { return data_; }
+
+  /// Not in Kaldi. Always true with this storage.
+  bool IsContiguous() const { return true; }
+
+  inline Real operator() (MatrixIndexT i) const {
+    KALDI_PARANOID_ASSERT(static_cast<UnsignedMatrixIndexT>(i) <
+                          static_cast<UnsignedMatrixIndexT>(dim_));
+    return data_[i];
+  }
+
+  inline Real& operator() (MatrixIndexT i) {
+    KALDI_PARANOID_ASSERT(static_cast<UnsignedMatrixIndexT>(i) <
+                          static_cast<UnsignedMatrixIndexT>(dim_));
+    return data_[i];
+  }
+
+  SubVector<Real> Range(const MatrixIndexT o, const MatrixIndexT l) {
+    return SubVector<Real>(*this, o, l);
+  }
+
+  const SubVector<Real> Range(const MatrixIndexT o,
+                              const MatrixIndexT l) const {
+    return SubVector<Real>(*this, o, l);
+  }
+
+  void CopyFromVec(const VectorBase<Real> &v) {
+    KALDI_ASSERT(dim_ == v.dim_);
+    if (data_ != v.data_)
+      std::copy(v.data_, v.data_ + dim_, data_);
+  }
+
+  void ApplyFloor(Real floor_val, MatrixIndexT *floored_count = nullptr) {
+    MatrixIndexT num_floored = 0;
+    for (MatrixIndexT i = 0; i < dim_; i++) {
+      if (data_[i] < floor_val) {
+        data_[i] = floor_val;
+        num_floored++;
+      }
+    }
+    if (floored_count) *floored_count = num_floored;
+  }
+
+  void ApplyPow(Real power) {
+    if (power == 2.0) {
+      for (MatrixIndexT i = 0; i < dim_; i++)
+        data_[i] *= data_[i];
+    } else if (power == 0.5) {
+      for (MatrixIndexT i = 0; i < dim_; i++)
+        data_[i] = std::sqrt(data_[i]);
+    } else if (power != 1.0) {
+      for (MatrixIndexT i = 0; i < dim_; i++)
+        data_[i] = std::pow(data_[i], power);
+    }
+    for (MatrixIndexT i = 0; i < dim_; i++)
+      if (data_[i] != data_[i])
+        KALDI_ERR << "Could not raise element " << i << " to power "
+                  << power << ": returned value = " << data_[i];
+  }
+
+  template<typename OtherReal>
+  void AddVec(const Real alpha, const VectorBase<OtherReal> &v) {
+    KALDI_ASSERT(dim_ == v.Dim());
+    const OtherReal *other = v.Data();
+    for (MatrixIndexT i = 0; i < dim_; i++)
+      data_[i] += alpha * other[i];
+  }
+
+  void AddVec2(const Real alpha, const VectorBase<Real> &v) {
+    KALDI_ASSERT(dim_ == v.dim_);
+    for (MatrixIndexT i = 0; i < dim_; i++)
+      data_[i] += alpha * (v.data_[i] * v.data_[i]);
+  }
+
+  void AddMatVec(const Real alpha, const MatrixBase<Real> &M,
+                 const MatrixTransposeType trans,  const VectorBase<Real> &v,
+                 const Real beta) { // **beta previously defaulted to 0.0**
+    const MatrixIndexT num_rows = M.NumRows(), num_cols = M.NumCols();
+    if (trans == kNoTrans) {
+      KALDI_ASSERT(dim_ == num_rows && v.dim_ == num_cols);
+      for (MatrixIndexT r = 0; r < num_rows; r++) {
+        const Real sum = internal::Dot(M.RowData(r), v.data_, num_cols);
+        data_[r] = (beta == 0.0 ? 0 : beta * data_[r]) + alpha * sum;
+      }
+    } else {
+      KALDI_ASSERT(dim_ == num_cols && v.dim_ == num_rows);
+      std::vector<Real> sum(num_cols, Real(0));
+      for (MatrixIndexT r = 0; r < num_rows; r++) {
+        const Real *row = M.RowData(r), x = v.data_[r];
+        for (MatrixIndexT c = 0; c < num_cols; c++)
+          sum[c] += row[c] * x;
+      }
+      for (MatrixIndexT c = 0; c < num_cols; c++)
+        data_[c] = (beta == 0.0 ? 0 : beta * data_[c]) + alpha * sum[c];
+    }
+  }
+
+  void MulElements(const VectorBase<Real> &v) {
+    KALDI_ASSERT(dim_ == v.dim_);
+    for (MatrixIndexT i = 0; i < dim_; i++)
+      data_[i] *= v.data_[i];
+  }
+
+  void Add(Real c) {
+    for (MatrixIndexT i = 0; i < dim_; i++)
+      data_[i] += c;
+  }
+
+  void AddVecVec(Real alpha, const VectorBase<Real> &v,
+                 const VectorBase<Real> &r, Real beta) {
+    KALDI_ASSERT(dim_ == v.dim_ && dim_ == r.dim_);
+    for (MatrixIndexT i = 0; i < dim_; i++)
+      data_[i] = beta * data_[i] + alpha * v.data_[i] * r.data_[i];
+  }
+
+  void Scale(Real alpha) {
+    for (MatrixIndexT i = 0; i < dim_; i++)
+      data_[i] *= alpha;
+  }
+
+  Real Min() const {
+    Real ans = std::numeric_limits<Real>::infinity();
+    for (MatrixIndexT i = 0; i < dim_; i++)
+      if (data_[i] < ans) ans = data_[i];
+    return ans;
+  }
+
+  Real Min(MatrixIndexT *index) const {
+    KALDI_ASSERT(dim_ > 0);
+    MatrixIndexT ans = 0;
+    for (MatrixIndexT i = 1; i < dim_; i++)
+      if (data_[i] < data_[ans]) ans = i;
+    *index = ans;
+    return data_[ans];
+  }
+
+  Real Sum() const { return internal::Sum(data_, dim_); }
+
+  // Note: these reduce M directly and update this vector in place, instead
+  // of multiplying M by a vector of ones / forming M * M^T.
+  void AddRowSumMat(Real alpha, const MatrixBase<Real> &M, Real beta = 1.0) {
+    KALDI_ASSERT(dim_ == M.NumCols());
+    std::vector<Real> sum(dim_, Real(0));
+    for (MatrixIndexT r = 0; r < M.NumRows(); r++) {
+      const Real *row = M.RowData(r);
+      for (MatrixIndexT c = 0; c < dim_; c++)
+        sum[c] += row[c];
+    }
+    AddReduced(alpha, sum.data(), beta);
+  }
+
+  void AddColSumMat(Real alpha, const MatrixBase<Real> &M, Real beta = 1.0) {
+    KALDI_ASSERT(dim_ == M.NumRows());
+    std::vector<Real> sum(dim_);
+    for (MatrixIndexT r = 0; r < dim_; r++)
+      sum[r] = internal::Sum(M.RowData(r), M.NumCols());
+    AddReduced(alpha, sum.data(), beta);
+  }
+
+  void AddDiagMat2(Real alpha, const MatrixBase<Real> &M,
+                   MatrixTransposeType trans = kNoTrans, Real beta = 1.0) {
+    // The diagonal of M * M^T holds the sums of squares of the rows of M.
+    const MatrixIndexT num_rows = M.NumRows(), num_cols = M.NumCols();
+    std::vector<Real> sum(dim_, Real(0));
+    if (trans == kNoTrans) {
+      KALDI_ASSERT(dim_ == num_rows);
+      for (MatrixIndexT r = 0; r < num_rows; r++)
+        sum[r] = internal::Dot(M.RowData(r), M.RowData(r), num_cols);
+    } else {
+      KALDI_ASSERT(dim_ == num_cols);
+      for (MatrixIndexT r = 0; r < num_rows; r++) {
+        const Real *row = M.RowData(r);
+        for (MatrixIndexT c = 0; c < num_cols; c++)
+          sum[c] += row[c] * row[c];
+      }
+    }
+    AddReduced(alpha, sum.data(), beta);
+  }
+
+protected:
+  // this = beta * this + alpha * sum. Like BLAS, ignores the current value
+  // (which may be NaN) when beta is 0.
+  void AddReduced(Real alpha, const Real *sum, Real beta) {
+    if (beta == 0.0) {
+      for (MatrixIndexT i = 0; i < dim_; i++)
+        data_[i] = alpha == 1.0 ? sum[i] : sum[i] * alpha;
+    } else {
+      for (MatrixIndexT i = 0; i < dim_; i++) {
+        if (beta != 1.0) data_[i] *= beta;
+        data_[i] += alpha * sum[i];
+      }
+    }
+  }
+
+  explicit VectorBase() : data_(NULL), dim_(0), capacity_(0) {
+    KALDI_ASSERT_IS_FLOATING_TYPE(Real);
+  }
+
+  template<typename> friend struct SubVector;
+
+  // Keeps the memory at data_ alive; NULL if it is not owned (e.g. a
+  // SubVector made from a pointer).
+  std::shared_ptr<void> storage_;
+  Real *data_;
+  MatrixIndexT dim_;
+  // Number of elements of storage_ from data_ on; only used by Vector.
+  size_t capacity_;
+};
+
+template<typename Real>
+struct Vector : VectorBase<Real> {
+  Vector(): VectorBase<Real>() {};
+
+  explicit Vector(const MatrixIndexT s,
+                  MatrixResizeType resize_type = kSetZero)
+      : VectorBase<Real>() {  Resize(s, resize_type);  }
+
+  // Note: unlike the original implementation, this is "explicit".
+  explicit Vector(const Vector<Real> &v) : VectorBase<Real>() {
+    Resize(v.Dim(), kUndefined);
+    this->CopyFromVec(v);
+  }
+
+  explicit Vector(const VectorBase<Real> &v) : VectorBase<Real>() {
+    Resize(v.Dim(), kUndefined);
+    this->CopyFromVec(v);
+  }
+
+  void Swap(Vector<Real> *other) {
+    std::swap(this->storage_, other->storage_);
+    std::swap(this->data_, other->data_);
+    std::swap(this->dim_, other->dim_);
+    std::swap(this->capacity_, other->capacity_);
+  }
+
+  void Resize(MatrixIndexT length, MatrixResizeType resize_type = kSetZero) {
+    KALDI_ASSERT(length >= 0);
+    GetResizeStats().num_resizes++;
+    const MatrixIndexT num_kept =
+      resize_type == kCopyData ? std::min(length, this->dim_) : 0;
+    if (static_cast<size_t>(length) > this->capacity_)
+      Allocate(length, num_kept);
+    this->dim_ = length;
+    if (resize_type == kSetZero)
+      this->SetZero();
+    else if (resize_type == kCopyData)
+      // Only the newly exposed part needs zeroing.
+      std::fill(this->data_ + num_kept, this->data_ + length, Real(0));
+  }
+
+  /// Not in Kaldi. Makes the following Resize calls up to `capacity`
+  /// elements allocation-free.
+  void Reserve(MatrixIndexT capacity) {
+    if (static_cast<size_t>(capacity) > this->capacity_)
+      Allocate(capacity, this->dim_);
+  }
+
+  /// Not in Kaldi. Same as Reserve(): without libtorch, there is no process
+  /// to hand the result to.
+  void ReserveShared(MatrixIndexT capacity) { Reserve(capacity); }
+
+  Vector<Real> &operator = (const VectorBase<Real> &other) {
+    Resize(other.Dim(), kUndefined);
+    this->CopyFromVec(other);
+    return *this;
+  }
+
+ private:
+  // Replaces the storage by new storage of `capacity` elements, which holds
+  // the first `num_kept` elements of the current one.
+  void Allocate(MatrixIndexT capacity, MatrixIndexT num_kept) {
+    std::shared_ptr<void> storage =
+      internal::AllocateStorage(sizeof(Real) * static_cast<size_t>(capacity));
+    Real *data = static_cast<Real*>(storage.get());
+    if (num_kept > 0) std::copy(this->data_, this->data_ + num_kept, data);
+    this->storage_ = storage;
+    this->data_ = data;
+    this->capacity_ = capacity;
+  }
+};
+
+template<typename Real>
+struct SubVector : VectorBase<Real> {
+  SubVector(const VectorBase<Real> &t, const MatrixIndexT origin,
+            const MatrixIndexT length) : VectorBase<Real>() {
+    KALDI_ASSERT(origin >= 0 && length >= 0 && origin + length <= t.dim_);
+    this->storage_ = t.storage_;
+    this->data_ = t.data_ + origin;
+    this->dim_ = length;
+  }
+
+  // NOTE: This should not take the ownership of the underlying memory object
+  SubVector(const Real *data, MatrixIndexT length) : VectorBase<Real>() {
+    this->data_ = const_cast<Real*>(data);
+    this->dim_ = length;
+  }
+
+  SubVector(const MatrixBase<Real> &matrix, MatrixIndexT row)
+      : VectorBase<Real>() {
+    KALDI_ASSERT(static_cast<UnsignedMatrixIndexT>(row) <
+                 static_cast<UnsignedMatrixIndexT>(matrix.NumRows()));
+    this->storage_ = matrix.storage_;
+    this->data_ = const_cast<Real*>(matrix.RowData(row));
+    this->dim_ = matrix.NumCols();
+  }
+};
+
+template<typename Real>
+std::ostream & operator << (std::ostream & out, const VectorBase<Real> & v) {
+  out << " [ ";
+  for (MatrixIndexT i = 0; i < v.Dim(); i++)
+    out << v(i) << " ";
+  out << "]\n";
+  return out;
+}
+
+template<typename Real>
+Real VecVec(const VectorBase<Real> &v1, const VectorBase<Real> &v2) {
+  KALDI_ASSERT(v1.Dim() == v2.Dim());
+  return internal::Dot(v1.Data(), v2.Data(), v1.Dim());
+}
+
+} // namespace kaldi
+
+#endif
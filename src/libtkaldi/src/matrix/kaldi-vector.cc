@@ -24,9 +24,19 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#include <unistd.h>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <sstream>
+#ifndef KALDI_LEAN_STORAGE
+#include <ATen/MapAllocator.h>
+#endif
 #include "matrix/kaldi-vector.h"
 #include "matrix/kaldi-matrix.h"
 
+#ifndef KALDI_LEAN_STORAGE
 namespace {
 
 template<typename Real>
@@ -45,18 +55,122 @@ void assert_vector_shape<double>(const torch::Tensor &tensor_) {
 }
 
 } // namespace
+#endif  // KALDI_LEAN_STORAGE
 
 namespace kaldi {
 
+ResizeStats &GetResizeStats() {
+  thread_local ResizeStats stats;
+  return stats;
+}
+
+#ifdef KALDI_LEAN_STORAGE
+namespace internal {
+
+std::shared_ptr<void> AllocateStorage(size_t num_bytes) {
+  void *data = NULL;
+  // Empty allocations may return NULL.
+  if (posix_memalign(&data, kStorageAlignment,
+                     std::max<size_t>(num_bytes, 1)) != 0)
+    throw std::bad_alloc();
+  auto &stats = GetResizeStats();
+  stats.num_reallocations++;
+  stats.bytes_allocated += num_bytes;
+  return std::shared_ptr<void>(data, free);
+}
+
+} // namespace internal
+#else
+namespace internal {
+
+torch::Tensor AllocateTensor(at::IntArrayRef sizes, const torch::TensorOptions &options) {
+  auto tensor = torch::empty(sizes, options);
+  auto &stats = GetResizeStats();
+  stats.num_reallocations++;
+  stats.bytes_allocated += tensor.numel() * tensor.element_size();
+  return tensor;
+}
+
+torch::Tensor AllocateSharedTensor(at::IntArrayRef sizes,
+                                   const torch::TensorOptions &options) {
+  static std::atomic<int64> counter(0);
+  int64_t numel = 1;
+  for (auto size : sizes) {
+    numel *= size;
+  }
+  // Empty mappings are not allowed.
+  const size_t nbytes = std::max<size_t>(
+    static_cast<size_t>(numel) * options.dtype().itemsize(), 1);
+  std::ostringstream handle;
+  handle << "/tkaldi_" << getpid() << "_" << counter++ << "_"
+         << std::random_device()();
+  const int flags = at::ALLOCATOR_MAPPED_SHAREDMEM |
+    at::ALLOCATOR_MAPPED_EXCLUSIVE | at::ALLOCATOR_MAPPED_KEEPFD |
+    at::ALLOCATOR_MAPPED_UNLINK;
+  at::Storage storage(
+    c10::Storage::use_byte_size_t(), nbytes,
+    at::MapAllocator::makeDataPtr(handle.str(), flags, nbytes, nullptr),
+    /*allocator=*/nullptr, /*resizable=*/false);
+  auto tensor = torch::empty({0}, options).set_(storage, 0, sizes);
+  auto &stats = GetResizeStats();
+  stats.num_reallocations++;
+  stats.bytes_allocated += nbytes;
+  return tensor;
+}
+
+bool IsSharedTensor(const torch::Tensor &tensor) {
+  return at::MapAllocator::fromDataPtr(tensor.storage().data_ptr()) != nullptr;
+}
+
+bool ResizeTensor(torch::Tensor *tensor, at::IntArrayRef sizes) {
+  GetResizeStats().num_resizes++;
+  int64_t numel = 1;
+  for (auto size : sizes) {
+    numel *= size;
+  }
+  // resize_ keeps the storage as long as it is big enough; check it here so
+  // that the allocations are accounted for, and so that storages which are
+  // not resizable (e.g. externally owned memory) are replaced instead.
+  const auto &storage = tensor->storage();
+  const size_t required =
+    static_cast<size_t>(tensor->storage_offset() + numel) * tensor->element_size();
+  if (tensor->is_contiguous() && storage.nbytes() >= required) {
+    tensor->resize_(sizes);
+    return false;
+  }
+  *tensor = AllocateTensor(sizes, tensor->options());
+  return true;
+}
+
+void ReserveTensor(torch::Tensor *tensor, int64_t capacity, bool shared) {
+  const size_t required =
+    static_cast<size_t>(tensor->storage_offset() + capacity) * tensor->element_size();
+  if (tensor->is_contiguous() && tensor->storage().nbytes() >= required &&
+      (!shared || IsSharedTensor(*tensor))) {
+    return;
+  }
+  auto numel = tensor->numel();
+  auto buffer = shared ?
+    AllocateSharedTensor({std::max(capacity, numel)}, tensor->options()) :
+    AllocateTensor({std::max(capacity, numel)}, tensor->options());
+  auto reserved = buffer.narrow(0, 0, numel).view(tensor->sizes());
+  reserved.copy_(*tensor);
+  *tensor = reserved;
+}
+
+} // namespace internal
+
 template<typename Real>
 VectorBase<Real>::VectorBase(torch::Tensor tensor) : tensor_(tensor) {
   assert_vector_shape<Real>(tensor_);
 };
 
 template<typename Real>
-VectorBase<Real>::VectorBase() : tensor_(torch::empty({0})) {
+VectorBase<Real>::VectorBase()
+    : tensor_(torch::empty({0}, c10::CppTypeToScalarType<Real>::value)) {
   assert_vector_shape<Real>(tensor_);
 }
+#endif  // KALDI_LEAN_STORAGE
 
 template struct Vector<float>;
 template struct Vector<double>;
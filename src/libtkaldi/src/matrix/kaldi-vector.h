@@ -29,14 +29,73 @@
 #ifndef KALDI_MATRIX_KALDI_VECTOR_H_
 #define KALDI_MATRIX_KALDI_VECTOR_H_
 
-#include <torch/torch.h>
 #include "matrix/matrix-common.h"
 
+namespace kaldi {
+
+template<typename Real> struct MatrixBase;
+
+////////////////////////////////////////////////////////////////////////////////
+// Storage management shared by Vector and Matrix
+////////////////////////////////////////////////////////////////////////////////
+/// Counters of the storage allocations made by Vector::Resize and
+/// Matrix::Resize. They are kept per thread, so that the caller can reset them
+/// before processing an utterance and read them back afterwards.
+struct ResizeStats {
+  int64 num_resizes = 0;
+  int64 num_reallocations = 0;
+  int64 bytes_allocated = 0;
+};
+
+/// Returns the counters of the calling thread.
+ResizeStats &GetResizeStats();
+
+} // namespace kaldi
+
+// Not in Kaldi. The storage of Vector and Matrix is selected at compile time.
+// By default it is a torch::Tensor, as defined below and in
+// matrix/kaldi-matrix.h. With KALDI_LEAN_STORAGE defined, it is a plain
+// aligned buffer (matrix/kaldi-vector-lean.h and matrix/kaldi-matrix-lean.h)
+// with the same methods, which does not need libtorch; the command-line tools
+// can be built that way (see BUILD_LEAN_CLI in CMakeLists.txt).
+#ifdef KALDI_LEAN_STORAGE
+#include "matrix/kaldi-vector-lean.h"
+#else
+
+#include <torch/torch.h>
+
 using namespace torch::indexing;
 
 namespace kaldi {
 
-template<typename Real> struct MatrixBase;
+namespace internal {
+
+/// Allocates an uninitialized tensor and records it in ResizeStats.
+torch::Tensor AllocateTensor(at::IntArrayRef sizes, const torch::TensorOptions &options);
+
+/// Same as AllocateTensor(), in shared memory: the storage is a mapping of an
+/// unlinked POSIX shared memory object whose file descriptor is kept, as the
+/// "file_descriptor" sharing strategy of torch.multiprocessing allocates it,
+/// so sending the tensor to another process passes the descriptor instead of
+/// copying the data.
+torch::Tensor AllocateSharedTensor(at::IntArrayRef sizes,
+                                   const torch::TensorOptions &options);
+
+/// Whether the storage of `tensor` is in shared memory.
+bool IsSharedTensor(const torch::Tensor &tensor);
+
+/// Resizes `tensor` to `sizes`. The existing storage is reused (no allocation)
+/// when it is large enough, so shrinking and re-growing within the capacity
+/// is free. Otherwise `tensor` is replaced by a new, uninitialized tensor.
+/// Returns true if new storage was allocated.
+bool ResizeTensor(torch::Tensor *tensor, at::IntArrayRef sizes);
+
+/// Makes sure the storage of `tensor` can hold `capacity` elements without
+/// changing its shape or content. If `shared`, also makes sure the storage is
+/// in shared memory (see AllocateSharedTensor()).
+void ReserveTensor(torch::Tensor *tensor, int64_t capacity, bool shared = false);
+
+} // namespace internal
 
 // https://github.com/kaldi-asr/kaldi/blob/7fb716aa0f56480af31514c7e362db5c9f787fd4/src/matrix/kaldi-vector.h#L36-L40
 template<typename Real>
@@ -67,6 +126,10 @@ struct VectorBase {
   // https://github.com/kaldi-asr/kaldi/blob/7fb716aa0f56480af31514c7e362db5c9f787fd4/src/matrix/kaldi-vector.h#L71-L72
   inline const Real* Data() const { return tensor_.data_ptr<Real>(); }
 
+  /// Not in Kaldi. Whether the elements are adjacent in memory, as Kaldi
+  /// assumes; a VectorBase can view a strided tensor (e.g. a column).
+  bool IsContiguous() const { return tensor_.is_contiguous(); }
+
   // https://github.com/kaldi-asr/kaldi/blob/7fb716aa0f56480af31514c7e362db5c9f787fd4/src/matrix/kaldi-vector.h#L74-L79
   inline Real operator() (MatrixIndexT i) const {
     return tensor_.index({i}).item().to<Real>();
@@ -175,32 +238,40 @@ struct VectorBase {
 
   // https://github.com/kaldi-asr/kaldi/blob/7fb716aa0f56480af31514c7e362db5c9f787fd4/src/matrix/kaldi-vector.h#L320-L321
   // https://github.com/kaldi-asr/kaldi/blob/7fb716aa0f56480af31514c7e362db5c9f787fd4/src/matrix/kaldi-vector.cc#L718-L736
+  // Note: these reduce M directly and update this vector in place, instead
+  // of multiplying M by a vector of ones / forming M * M^T.
   void AddRowSumMat(Real alpha, const MatrixBase<Real> &M, Real beta = 1.0) {
-    Vector<Real> ones(M.NumRows());
-    ones.Set(1.0);
-    this->AddMatVec(alpha, M, kTrans, ones, beta);
+    AddReduced(alpha, M.tensor_.sum(0), beta);
   }
 
   // https://github.com/kaldi-asr/kaldi/blob/7fb716aa0f56480af31514c7e362db5c9f787fd4/src/matrix/kaldi-vector.h#L323-L324
   // https://github.com/kaldi-asr/kaldi/blob/7fb716aa0f56480af31514c7e362db5c9f787fd4/src/matrix/kaldi-vector.cc#L738-L757
   void AddColSumMat(Real alpha, const MatrixBase<Real> &M, Real beta = 1.0) {
-    Vector<Real> ones(M.NumCols());
-    ones.Set(1.0);
-    this->AddMatVec(alpha, M, kNoTrans, ones, beta);
+    AddReduced(alpha, M.tensor_.sum(1), beta);
   }
 
   // https://github.com/kaldi-asr/kaldi/blob/7fb716aa0f56480af31514c7e362db5c9f787fd4/src/matrix/kaldi-vector.h#L326-L330
   void AddDiagMat2(Real alpha, const MatrixBase<Real> &M,
                    MatrixTransposeType trans = kNoTrans, Real beta = 1.0) {
-    auto mat = M.tensor_;
-    if (trans == kNoTrans) {
-      tensor_ = beta * tensor_ + torch::diag(torch::mm(mat, mat.transpose(1, 0)));
+    // The diagonal of M * M^T holds the sums of squares of the rows of M.
+    auto squares = M.tensor_.square();
+    AddReduced(alpha, squares.sum(trans == kNoTrans ? 1 : 0), beta);
+  }
+
+protected:
+  // this = beta * this + alpha * sum. Like BLAS, ignores the current value
+  // (which may be NaN) when beta is 0.
+  void AddReduced(Real alpha, const torch::Tensor &sum, Real beta) {
+    TORCH_INTERNAL_ASSERT(tensor_.sizes() == sum.sizes());
+    if (beta == 0.0) {
+      tensor_.copy_(sum);
+      if (alpha != 1.0) tensor_.mul_(alpha);
     } else {
-      tensor_ = beta * tensor_ + torch::diag(torch::mm(mat.transpose(1, 0), mat));
+      if (beta != 1.0) tensor_.mul_(beta);
+      tensor_.add_(sum, alpha);
     }
   }
 
-protected:
   // https://github.com/kaldi-asr/kaldi/blob/7fb716aa0f56480af31514c7e362db5c9f787fd4/src/matrix/kaldi-vector.h#L362-L365
   explicit VectorBase();
 };
@@ -245,21 +316,40 @@ struct Vector : VectorBase<Real> {
     auto &tensor_ = VectorBase<Real>::tensor_;
     switch(resize_type) {
     case kSetZero:
-      tensor_.resize_({length}).zero_();
+      internal::ResizeTensor(&tensor_, {length});
+      tensor_.zero_();
       break;
     case kUndefined:
-      tensor_.resize_({length});
+      internal::ResizeTensor(&tensor_, {length});
       break;
     case kCopyData:
-      auto tmp = tensor_;
-      auto tmp_numel = tensor_.numel();
-      tensor_.resize_({length}).zero_();
-      auto numel = Slice(length < tmp_numel ? length : tmp_numel);
-      tensor_.index_put_({numel}, tmp.index({numel}));
+      // Keep a handle to the current storage, in case it gets replaced.
+      auto old = tensor_;
+      auto num_kept = std::min<MatrixIndexT>(length, old.numel());
+      if (internal::ResizeTensor(&tensor_, {length}) && num_kept) {
+        tensor_.narrow(0, 0, num_kept).copy_(old.narrow(0, 0, num_kept));
+      }
+      // Only the newly exposed part needs zeroing.
+      if (length > num_kept) {
+        tensor_.narrow(0, num_kept, length - num_kept).zero_();
+      }
       break;
     }
   }
 
+  /// Not in Kaldi. Makes the following Resize calls up to `capacity`
+  /// elements allocation-free.
+  void Reserve(MatrixIndexT capacity) {
+    internal::ReserveTensor(&(this->tensor_), capacity);
+  }
+
+  /// Not in Kaldi. Same as Reserve(), with the storage in shared memory, so
+  /// that the result can be handed to another process without a copy as
+  /// long as it fits in `capacity`.
+  void ReserveShared(MatrixIndexT capacity) {
+    internal::ReserveTensor(&(this->tensor_), capacity, true);
+  }
+
   // https://github.com/kaldi-asr/kaldi/blob/7fb716aa0f56480af31514c7e362db5c9f787fd4/src/matrix/kaldi-vector.h#L463-L468
   Vector<Real> &operator = (const VectorBase<Real> &other) {
     Resize(other.Dim(), kUndefined);
@@ -304,4 +394,6 @@ Real VecVec(const VectorBase<Real> &v1, const VectorBase<Real> &v2) {
 
 } // namespace kaldi
 
+#endif  // KALDI_LEAN_STORAGE
+
 #endif
@@ -0,0 +1,71 @@
+// matrix/reduced-precision.h
+
+// Not in Kaldi.
+//
+// Read-only views of matrices stored in reduced precision.
+//
+// VectorBase / MatrixBase hold float or double only. Features which are kept
+// for a long time, and large intermediate buffers which are read more often
+// than they are computed (e.g. the NCCF of all the frames of an utterance),
+// can instead be stored as c10::Half or c10::BFloat16, at half the memory and
+// memory bandwidth. The kernels which accept a StorageMatrix are templated on
+// the element type and widen each value to float as they read it, so the
+// matrix is never converted as a whole. Widening is exact, so the result is
+// the same as that of the float kernel on the widened values.
+//
+// Instantiations are provided for float, c10::Half and c10::BFloat16; with
+// the lean storage (KALDI_LEAN_STORAGE, see matrix/kaldi-vector.h), which
+// does not use c10, for float only.
+//
+// Out of scope: an int16 PCM input path (the first stage of the pitch
+// extractor is upstream's LinearResample over float vectors, and WaveData
+// widens the samples as it reads the file), and float16 / bfloat16 storage
+// of the features written to archives, which have no such matrix type
+// (CompressedMatrix is the archive-level option).
+
+#ifndef KALDI_MATRIX_REDUCED_PRECISION_H_
+#define KALDI_MATRIX_REDUCED_PRECISION_H_
+
+#ifndef KALDI_LEAN_STORAGE
+#include <c10/util/BFloat16.h>
+#include <c10/util/Half.h>
+#endif
+#include "matrix/kaldi-matrix.h"
+
+namespace kaldi {
+
+template<typename Storage>
+struct StorageMatrix {
+  const Storage *data;
+  MatrixIndexT num_rows;
+  MatrixIndexT num_cols;
+  MatrixIndexT stride;  // distance between the starts of the rows
+
+  StorageMatrix(const Storage *data, MatrixIndexT num_rows,
+                MatrixIndexT num_cols, MatrixIndexT stride)
+      : data(data), num_rows(num_rows), num_cols(num_cols), stride(stride) {}
+
+#ifndef KALDI_LEAN_STORAGE
+  /// Views `tensor`, a matrix of Storage with contiguous rows.
+  explicit StorageMatrix(const torch::Tensor &tensor)
+      : data(tensor.data_ptr<Storage>()),
+        num_rows(tensor.size(0)), num_cols(tensor.size(1)),
+        stride(tensor.stride(0)) {
+    KALDI_ASSERT(tensor.dim() == 2 && (num_cols <= 1 || tensor.stride(1) == 1));
+  }
+#endif
+
+  const Storage *RowData(MatrixIndexT r) const {
+    return data + static_cast<size_t>(r) * stride;
+  }
+};
+
+/// Views a float matrix, for the float instantiation of the kernels.
+inline StorageMatrix<BaseFloat> MakeStorageMatrix(const MatrixBase<BaseFloat> &m) {
+  KALDI_ASSERT(m.HasContiguousRows());
+  return StorageMatrix<BaseFloat>(m.Data(), m.NumRows(), m.NumCols(), m.Stride());
+}
+
+} // namespace kaldi
+
+#endif
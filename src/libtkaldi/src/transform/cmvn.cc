@@ -0,0 +1,304 @@
+// transform/cmvn.cc
+
+// Copyright 2009-2013 Microsoft Corporation
+//                     Johns Hopkins University (author: Daniel Povey)
+
+// See https://github.com/kaldi-asr/kaldi/blob/7fb716aa0f56480af31514c7e362db5c9f787fd4/COPYING
+// for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+// Based on https://github.com/kaldi-asr/kaldi/blob/7fb716aa0f56480af31514c7e362db5c9f787fd4/src/transform/cmvn.cc
+
+#include <cmath>
+#include "transform/cmvn.h"
+#include "util/work-stealing-scheduler.h"
+
+namespace kaldi {
+
+namespace {
+
+// Adds the stats of `num_frames` frames of `dim` values, the starts of which
+// are `stride` apart, weighted by `weights` (if not NULL). The count, sum and
+// sum of squares are updated together, in one read of the features.
+template<typename Storage>
+void AccumulateFrames(const Storage *feats, int32 num_frames, int32 dim,
+                      MatrixIndexT stride, const BaseFloat *weights,
+                      MatrixBase<double> *stats) {
+  KALDI_ASSERT(stats->NumRows() == 2 && stats->NumCols() == dim + 1 &&
+               stats->HasContiguousRows());
+  // Remove these __restrict__ modifiers if they cause compilation problems.
+  double *__restrict__ mean_ptr = stats->RowData(0),
+      *__restrict__ var_ptr = stats->RowData(1);
+  double count = mean_ptr[dim];
+  for (int32 t = 0; t < num_frames; t++) {
+    const BaseFloat weight = (weights == NULL ? 1.0 : weights[t]);
+    if (weight == 0.0) continue;
+    const Storage *__restrict__ feats_ptr = feats + t * stride;
+    count += weight;
+    for (int32 d = 0; d < dim; d++) {
+      const BaseFloat x = static_cast<BaseFloat>(feats_ptr[d]);
+      mean_ptr[d] += x * weight;
+      var_ptr[d] += x * x * weight;
+    }
+  }
+  mean_ptr[dim] = count;
+}
+
+// The offset and scale of each dimension, as computed by ApplyCmvn() (or
+// ApplyCmvnReverse() if `reverse`); x(d) <-- x(d) * scale[d] + offset[d].
+void ComputeNormalization(const MatrixBase<double> &stats, bool var_norm,
+                          bool reverse, int32 feat_dim,
+                          std::vector<BaseFloat> *offset,
+                          std::vector<BaseFloat> *scale) {
+  int32 dim = stats.NumCols() - 1;
+  if (stats.NumRows() > 2 || stats.NumRows() < 1 || feat_dim != dim) {
+    KALDI_ERR << "Dim mismatch: cmvn "
+              << stats.NumRows() << 'x' << stats.NumCols()
+              << ", feats " << feat_dim << " columns";
+  }
+  if (stats.NumRows() == 1 && var_norm)
+    KALDI_ERR << "You requested variance normalization but no variance stats "
+              << "are supplied.";
+  // Contiguous copy, in case `stats` is a view.
+  Matrix<double> stats_copy(stats);
+  const double *mean_stats = stats_copy.RowData(0),
+      *var_stats = var_norm ? stats_copy.RowData(1) : NULL;
+  double count = mean_stats[dim];
+  // Do not change the threshold of 1.0 here: in the balanced-cmvn code, when
+  // computing an offset and representing it as stats, we use a count of one.
+  if (count < 1.0)
+    KALDI_ERR << "Insufficient stats for cepstral mean and variance "
+              << "normalization: count = " << count;
+
+  offset->resize(dim);
+  scale->resize(dim);
+  if (!var_norm && !reverse) {
+    // As Vector<BaseFloat>::AddVec(-1.0 / count, mean_stats).
+    const BaseFloat alpha = -1.0 / count;
+    for (int32 d = 0; d < dim; d++) {
+      (*offset)[d] = alpha * mean_stats[d];
+      (*scale)[d] = 1.0;
+    }
+    return;
+  }
+  for (int32 d = 0; d < dim; d++) {
+    double mean = mean_stats[d] / count, offset_d, scale_d;
+    if (!var_norm) {
+      scale_d = 1.0;
+      offset_d = mean;
+    } else {
+      double var = (var_stats[d] / count) - mean * mean,
+          floor = 1.0e-20;
+      if (var < floor) {
+        KALDI_WARN << "Flooring cepstral variance from " << var << " to "
+                   << floor;
+        var = floor;
+      }
+      if (reverse) {
+        // we aim to transform zero-mean, unit-variance input into data
+        // with the given mean and variance.
+        scale_d = sqrt(var);
+        offset_d = mean;
+      } else {
+        scale_d = 1.0 / sqrt(var);
+        if (scale_d != scale_d || 1 / scale_d == 0.0)
+          KALDI_ERR << "NaN or infinity in cepstral mean/variance computation";
+        offset_d = -(mean * scale_d);
+      }
+    }
+    (*offset)[d] = offset_d;
+    (*scale)[d] = scale_d;
+  }
+}
+
+// Normalizes `feats` in place, one row at a time.
+void Normalize(const std::vector<BaseFloat> &offset,
+               const std::vector<BaseFloat> *scale,  // or NULL
+               MatrixBase<BaseFloat> *feats) {
+  KALDI_ASSERT(feats->HasContiguousRows());
+  const int32 num_frames = feats->NumRows(), dim = feats->NumCols();
+  const MatrixIndexT stride = feats->Stride();
+  if (num_frames == 0 || dim == 0) return;
+  BaseFloat *data = feats->Data();
+  const BaseFloat *__restrict__ offset_ptr = offset.data(),
+      *__restrict__ scale_ptr = scale ? scale->data() : NULL;
+  for (int32 t = 0; t < num_frames; t++) {
+    BaseFloat *__restrict__ row = data + t * stride;
+    // Two roundings, as MulColsVec() followed by AddVecToRows().
+    if (scale_ptr != NULL)
+      for (int32 d = 0; d < dim; d++)
+        row[d] *= scale_ptr[d];
+    for (int32 d = 0; d < dim; d++)
+      row[d] += offset_ptr[d];
+  }
+}
+
+// Returns the elements of `v`, copied to `buffer` if they are not contiguous.
+const BaseFloat *ContiguousData(const VectorBase<BaseFloat> &v,
+                                Vector<BaseFloat> *buffer) {
+  if (v.IsContiguous()) return v.Data();
+  *buffer = v;
+  return buffer->Data();
+}
+
+void ApplyCmvnInternal(const MatrixBase<double> &stats, bool var_norm,
+                       bool reverse, MatrixBase<BaseFloat> *feats) {
+  KALDI_ASSERT(feats != NULL);
+  std::vector<BaseFloat> offset, scale;
+  ComputeNormalization(stats, var_norm, reverse, feats->NumCols(),
+                       &offset, &scale);
+  Normalize(offset, var_norm ? &scale : NULL, feats);
+}
+
+} // namespace
+
+// https://github.com/kaldi-asr/kaldi/blob/7fb716aa0f56480af31514c7e362db5c9f787fd4/src/transform/cmvn.cc#L25-L28
+void InitCmvnStats(int32 dim, Matrix<double> *stats) {
+  KALDI_ASSERT(dim > 0);
+  stats->Resize(2, dim+1);
+}
+
+// https://github.com/kaldi-asr/kaldi/blob/7fb716aa0f56480af31514c7e362db5c9f787fd4/src/transform/cmvn.cc#L30-L51
+void AccCmvnStats(const VectorBase<BaseFloat> &feats, BaseFloat weight,
+                  MatrixBase<double> *stats) {
+  KALDI_ASSERT(stats != NULL);
+  Vector<BaseFloat> buffer;
+  AccumulateFrames(ContiguousData(feats, &buffer), 1, feats.Dim(), feats.Dim(),
+                   &weight, stats);
+}
+
+// https://github.com/kaldi-asr/kaldi/blob/7fb716aa0f56480af31514c7e362db5c9f787fd4/src/transform/cmvn.cc#L53-L66
+void AccCmvnStats(const MatrixBase<BaseFloat> &feats,
+                  const VectorBase<BaseFloat> *weights,
+                  MatrixBase<double> *stats) {
+  AccCmvnStats(MakeStorageMatrix(feats), weights, stats);
+}
+
+template<typename Storage>
+void AccCmvnStats(const StorageMatrix<Storage> &feats,
+                  const VectorBase<BaseFloat> *weights,
+                  MatrixBase<double> *stats) {
+  KALDI_ASSERT(stats != NULL);
+  int32 num_frames = feats.num_rows;
+  if (weights != NULL)
+    KALDI_ASSERT(weights->Dim() == num_frames);
+  if (num_frames == 0) return;
+  Vector<BaseFloat> buffer;
+  AccumulateFrames(feats.data, num_frames, feats.num_cols, feats.stride,
+                   weights != NULL ? ContiguousData(*weights, &buffer) : NULL,
+                   stats);
+}
+
+// https://github.com/kaldi-asr/kaldi/blob/7fb716aa0f56480af31514c7e362db5c9f787fd4/src/transform/cmvn.cc#L68-L116
+void ApplyCmvn(const MatrixBase<double> &stats,
+               bool var_norm,
+               MatrixBase<BaseFloat> *feats) {
+  ApplyCmvnInternal(stats, var_norm, false, feats);
+}
+
+// https://github.com/kaldi-asr/kaldi/blob/7fb716aa0f56480af31514c7e362db5c9f787fd4/src/transform/cmvn.cc#L118-L167
+void ApplyCmvnReverse(const MatrixBase<double> &stats,
+                      bool var_norm,
+                      MatrixBase<BaseFloat> *feats) {
+  ApplyCmvnInternal(stats, var_norm, true, feats);
+}
+
+// https://github.com/kaldi-asr/kaldi/blob/7fb716aa0f56480af31514c7e362db5c9f787fd4/src/transform/cmvn.cc#L170-L182
+void FakeStatsForSomeDims(const std::vector<int32> &dims,
+                          MatrixBase<double> *stats) {
+  KALDI_ASSERT(stats->NumRows() == 2 && stats->NumCols() > 1);
+  int32 dim = stats->NumCols() - 1;
+  double count = (*stats)(0, dim);
+  for (size_t i = 0; i < dims.size(); i++) {
+    int32 d = dims[i];
+    KALDI_ASSERT(d >= 0 && d < dim);
+    (*stats)(0, d) = 0.0;
+    (*stats)(1, d) = count;
+  }
+}
+
+void AccCmvnStatsBatch(const std::vector<const MatrixBase<BaseFloat>*> &feats,
+                       const std::vector<const VectorBase<BaseFloat>*> &weights,
+                       const std::vector<int32> &groups,
+                       int32 num_threads,
+                       const std::vector<MatrixBase<double>*> &stats) {
+  std::vector<StorageMatrix<BaseFloat> > views;
+  views.reserve(feats.size());
+  for (const auto *f : feats)
+    views.push_back(MakeStorageMatrix(*f));
+  AccCmvnStatsBatch(views, weights, groups, num_threads, stats);
+}
+
+template<typename Storage>
+void AccCmvnStatsBatch(const std::vector<StorageMatrix<Storage> > &feats,
+                       const std::vector<const VectorBase<BaseFloat>*> &weights,
+                       const std::vector<int32> &groups,
+                       int32 num_threads,
+                       const std::vector<MatrixBase<double>*> &stats) {
+  KALDI_ASSERT(groups.size() == feats.size() &&
+               (weights.empty() || weights.size() == feats.size()));
+  const int32 num_groups = stats.size();
+  std::vector<std::vector<size_t> > members(num_groups);
+  std::vector<int64> costs(num_groups, 0);
+  for (size_t i = 0; i < feats.size(); i++) {
+    KALDI_ASSERT(groups[i] >= 0 && groups[i] < num_groups);
+    members[groups[i]].push_back(i);
+    costs[groups[i]] += static_cast<int64>(feats[i].num_rows) *
+                        feats[i].num_cols;
+  }
+  WorkStealingScheduler scheduler(num_threads);
+  for (int32 g = 0; g < num_groups; g++) {
+    if (members[g].empty()) continue;
+    scheduler.AddTask(costs[g], [&, g]() {
+      for (size_t i : members[g])
+        AccCmvnStats(feats[i], weights.empty() ? NULL : weights[i],
+                     stats[g]);
+    });
+  }
+  scheduler.Run();
+}
+
+void ApplyCmvnBatch(const std::vector<const MatrixBase<double>*> &stats,
+                    bool norm_vars, bool reverse, int32 num_threads,
+                    const std::vector<MatrixBase<BaseFloat>*> &feats) {
+  KALDI_ASSERT(stats.size() == feats.size());
+  WorkStealingScheduler scheduler(num_threads);
+  for (size_t i = 0; i < feats.size(); i++) {
+    scheduler.AddTask(
+      static_cast<int64>(feats[i]->NumRows()) * feats[i]->NumCols(),
+      [&, i]() { ApplyCmvnInternal(*stats[i], norm_vars, reverse, feats[i]); });
+  }
+  scheduler.Run();
+}
+
+#define INSTANTIATE_CMVN_STORAGE(Storage)                                   \
+  template void AccCmvnStats(const StorageMatrix<Storage> &feats,           \
+                             const VectorBase<BaseFloat> *weights,          \
+                             MatrixBase<double> *stats);                    \
+  template void AccCmvnStatsBatch(                                          \
+    const std::vector<StorageMatrix<Storage> > &feats,                      \
+    const std::vector<const VectorBase<BaseFloat>*> &weights,               \
+    const std::vector<int32> &groups, int32 num_threads,                    \
+    const std::vector<MatrixBase<double>*> &stats);
+
+INSTANTIATE_CMVN_STORAGE(float)
+#ifndef KALDI_LEAN_STORAGE
+INSTANTIATE_CMVN_STORAGE(c10::Half)
+INSTANTIATE_CMVN_STORAGE(c10::BFloat16)
+#endif
+
+#undef INSTANTIATE_CMVN_STORAGE
+
+} // namespace kaldi
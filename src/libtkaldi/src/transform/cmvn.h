@@ -0,0 +1,115 @@
+// transform/cmvn.h
+
+// Copyright 2009-2013 Microsoft Corporation
+//                     Johns Hopkins University (author: Daniel Povey)
+
+// See https://github.com/kaldi-asr/kaldi/blob/7fb716aa0f56480af31514c7e362db5c9f787fd4/COPYING
+// for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+// Based on https://github.com/kaldi-asr/kaldi/blob/7fb716aa0f56480af31514c7e362db5c9f787fd4/src/transform/cmvn.h
+//
+// Unlike the original, the whole-matrix functions walk the rows through raw
+// pointers (one read of the features, without a tensor view per frame), and
+// there are batched versions which process groups of matrices in parallel.
+// The arithmetic is the same as in Kaldi, so the results are identical.
+
+#ifndef KALDI_TRANSFORM_CMVN_H_
+#define KALDI_TRANSFORM_CMVN_H_
+
+#include <vector>
+#include "base/kaldi-common.h"
+#include "matrix/kaldi-matrix.h"
+#include "matrix/reduced-precision.h"
+
+namespace kaldi {
+
+/// This function initializes the matrix to dimension 2 by (dim+1);
+/// 1st "dim" elements of 1st row are mean stats, 1st "dim" elements
+/// of 2nd row are var stats, last element of 1st row is count,
+/// last element of 2nd row is zero.
+void InitCmvnStats(int32 dim, Matrix<double> *stats);
+
+/// Accumulation from a single frame (weighted).
+void AccCmvnStats(const VectorBase<BaseFloat> &feat,
+                  BaseFloat weight,
+                  MatrixBase<double> *stats);
+
+/// Accumulation from a feature file (possibly weighted-- useful in excluding
+/// silence).
+void AccCmvnStats(const MatrixBase<BaseFloat> &feats,
+                  const VectorBase<BaseFloat> *weights,  // or NULL
+                  MatrixBase<double> *stats);
+
+/// Not in Kaldi. Same as above, for features stored in reduced precision (see
+/// matrix/reduced-precision.h); each value is widened to float as it is read.
+template<typename Storage>
+void AccCmvnStats(const StorageMatrix<Storage> &feats,
+                  const VectorBase<BaseFloat> *weights,  // or NULL
+                  MatrixBase<double> *stats);
+
+/// Apply cepstral mean and variance normalization to a matrix of features.
+/// If norm_vars == true, expects stats to be of dimension 2 by (dim+1), but
+/// if norm_vars == false, will accept stats of dimension 1 by (dim+1); these
+/// are produced by the balanced-cmvn code when it computes an offset and
+/// represents it as "fake stats".
+void ApplyCmvn(const MatrixBase<double> &stats,
+               bool norm_vars,
+               MatrixBase<BaseFloat> *feats);
+
+/// This is as ApplyCmvn, but does so in the reverse sense, i.e. applies a
+/// transform that would take zero-mean, unit-variance input and turn it into
+/// output with the stats of "stats".  This can be useful if you trained
+/// without CMVN but later want to correct a mismatch, so you would first apply
+/// CMVN and then do the "reverse" CMVN with the summed training stats.
+void ApplyCmvnReverse(const MatrixBase<double> &stats,
+                      bool norm_vars,
+                      MatrixBase<BaseFloat> *feats);
+
+/// Modify the stats so that for some dimensions (specified in "dims"), we
+/// replace them with "fake" stats that have zero mean and unit variance; this
+/// is done to disable CMVN for those dimensions.
+void FakeStatsForSomeDims(const std::vector<int32> &dims,
+                          MatrixBase<double> *stats);
+
+/// Not in Kaldi. Accumulates the stats of feats[i] (weighted by weights[i],
+/// if `weights` is not empty and weights[i] is not NULL) into
+/// *stats[groups[i]], which must have been initialized, e.g. the utterances
+/// of each speaker. The groups are processed in parallel with
+/// `num_threads` threads; within a group, the matrices are accumulated in
+/// order, so the result does not depend on the number of threads.
+void AccCmvnStatsBatch(const std::vector<const MatrixBase<BaseFloat>*> &feats,
+                       const std::vector<const VectorBase<BaseFloat>*> &weights,
+                       const std::vector<int32> &groups,
+                       int32 num_threads,
+                       const std::vector<MatrixBase<double>*> &stats);
+
+/// Not in Kaldi. Same as above, for features stored in reduced precision.
+template<typename Storage>
+void AccCmvnStatsBatch(const std::vector<StorageMatrix<Storage> > &feats,
+                       const std::vector<const VectorBase<BaseFloat>*> &weights,
+                       const std::vector<int32> &groups,
+                       int32 num_threads,
+                       const std::vector<MatrixBase<double>*> &stats);
+
+/// Not in Kaldi. Applies ApplyCmvn (or ApplyCmvnReverse if `reverse`) with
+/// *stats[i] to *feats[i], in place, in parallel.
+void ApplyCmvnBatch(const std::vector<const MatrixBase<double>*> &stats,
+                    bool norm_vars, bool reverse, int32 num_threads,
+                    const std::vector<MatrixBase<BaseFloat>*> &feats);
+
+} // namespace kaldi
+
+#endif
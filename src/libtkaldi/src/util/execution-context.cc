@@ -0,0 +1,155 @@
+// util/execution-context.cc
+
+// Not in Kaldi.
+
+#include <dirent.h>
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#ifndef KALDI_LEAN_STORAGE
+#include <ATen/Parallel.h>
+#endif
+#include "util/execution-context.h"
+
+namespace kaldi {
+
+namespace {
+
+const char *kNodeDir = "/sys/devices/system/node";
+
+// Parses a CPU list such as "0-3,8,10-11".
+std::vector<int32> ParseCpuList(const std::string &list) {
+  std::vector<int32> cpus;
+  std::istringstream is(list);
+  std::string range;
+  while (std::getline(is, range, ',')) {
+    int32 first, last;
+    char dash;
+    std::istringstream rs(range);
+    if (!(rs >> first)) continue;
+    if (!(rs >> dash >> last)) last = first;
+    for (int32 cpu = first; cpu <= last; cpu++)
+      cpus.push_back(cpu);
+  }
+  return cpus;
+}
+
+// The NUMA node numbers, from the names of the directories "node<n>".
+std::vector<int32> ListNodes() {
+  std::vector<int32> ids;
+  DIR *d = opendir(kNodeDir);
+  if (d == NULL) return ids;
+  while (struct dirent *e = readdir(d)) {
+    int32 id;
+    char extra;
+    if (sscanf(e->d_name, "node%d%c", &id, &extra) == 1)
+      ids.push_back(id);
+  }
+  closedir(d);
+  std::sort(ids.begin(), ids.end());
+  return ids;
+}
+
+} // namespace
+
+ExecutionContext::ExecutionContext(const ExecutionOptions &opts)
+    : opts_(opts), saved_intra_op_threads_(0) {
+  if (opts.cpu_affinity != "none" && opts.cpu_affinity != "node" &&
+      opts.cpu_affinity != "cpu")
+    KALDI_ERR << "Invalid --cpu-affinity: " << opts.cpu_affinity;
+
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+    KALDI_ERR << "sched_getaffinity failed: " << strerror(errno);
+
+  for (int32 id : ListNodes()) {
+    std::ifstream is(std::string(kNodeDir) + "/node" + std::to_string(id) +
+                     "/cpulist");
+    std::string list;
+    std::getline(is, list);
+    std::vector<int32> cpus;
+    for (int32 cpu : ParseCpuList(list))
+      if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed))
+        cpus.push_back(cpu);
+    if (!cpus.empty()) {
+      nodes_.push_back(cpus);
+      node_ids_.push_back(id);
+    }
+  }
+  if (nodes_.empty()) {
+    std::vector<int32> cpus;
+    for (int32 cpu = 0; cpu < CPU_SETSIZE; cpu++)
+      if (CPU_ISSET(cpu, &allowed))
+        cpus.push_back(cpu);
+    nodes_.push_back(cpus);
+    node_ids_.push_back(-1);
+  }
+#ifndef KALDI_LEAN_STORAGE
+  if (opts.intra_op_threads > 0)
+    saved_intra_op_threads_ = at::get_num_threads();
+#endif
+}
+
+ExecutionContext::~ExecutionContext() {
+#ifndef KALDI_LEAN_STORAGE
+  if (saved_intra_op_threads_ > 0)
+    at::set_num_threads(saved_intra_op_threads_);
+#endif
+}
+
+void ExecutionContext::Configure(WorkStealingScheduler *scheduler) const {
+  if (opts_.intra_op_threads <= 0 && opts_.cpu_affinity == "none")
+    return;
+  scheduler->SetThreadInit([this](int32 index) { InitWorker(index); });
+}
+
+void ExecutionContext::InitWorker(int32 index) const {
+#ifndef KALDI_LEAN_STORAGE
+  if (opts_.intra_op_threads > 0)
+    at::set_num_threads(opts_.intra_op_threads);
+#endif
+  if (opts_.cpu_affinity == "none")
+    return;
+
+  // Consecutive workers go to different nodes.
+  const int32 num_nodes = nodes_.size(), node = index % num_nodes;
+  const std::vector<int32> &cpus = nodes_[node];
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (opts_.cpu_affinity == "node") {
+    for (int32 cpu : cpus)
+      CPU_SET(cpu, &set);
+  } else {
+    CPU_SET(cpus[(index / num_nodes) % cpus.size()], &set);
+  }
+  int ret = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  if (ret != 0)
+    KALDI_WARN << "Failed to set the CPU affinity of worker " << index
+               << ": " << strerror(ret);
+
+  // The memory first touched by the thread is taken from its node when
+  // possible (this is also the default policy, but it would follow the
+  // thread if it was not pinned).
+  const int32 node_id = node_ids_[node];
+  if (num_nodes > 1 && node_id >= 0) {
+    const int32 bits = 8 * sizeof(unsigned long);
+    std::vector<unsigned long> mask(node_id / bits + 1, 0);
+    mask[node_id / bits] |= 1UL << (node_id % bits);
+    // The kernel reads maxnode - 1 bits.
+    if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask.data(),
+                mask.size() * bits + 1) != 0)
+      KALDI_WARN << "Failed to set the memory policy of worker " << index
+                 << ": " << strerror(errno);
+  }
+}
+
+} // namespace kaldi
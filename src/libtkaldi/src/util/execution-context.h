@@ -0,0 +1,83 @@
+// util/execution-context.h
+
+// Not in Kaldi.
+//
+// Placement of the worker threads of a WorkStealingScheduler.
+//
+// The shim runs every Vector / Matrix operation as ATen ops, which may use
+// the intra-op thread pool; with several workers each running ATen ops with
+// as many threads as there are cores, the machine is oversubscribed. On
+// machines with several NUMA nodes, the workers may also drift between the
+// nodes, away from their memory; tests/perf_tests/execution_benchmark.sh
+// compares the placements, and no measurement is recorded here. An
+// ExecutionContext sets, on each worker thread:
+//  - if asked, the number of ATen intra-op threads (at::set_num_threads());
+//    this setting is process-wide with ATen's native thread pool, so the
+//    context saves the previous value and restores it when it is destroyed.
+//    There are none with the lean storage (KALDI_LEAN_STORAGE), whose
+//    kernels run on the calling thread,
+//  - the CPU affinity, either to a single CPU or to the CPUs of one NUMA
+//    node, dealing the workers round-robin over the nodes, and
+//  - in that case, the memory policy of the thread, so that the memory it
+//    allocates (the tensors of the utterances it processes) is taken from
+//    its node.
+
+#ifndef KALDI_UTIL_EXECUTION_CONTEXT_H_
+#define KALDI_UTIL_EXECUTION_CONTEXT_H_
+
+#include <string>
+#include <vector>
+#include "base/kaldi-common.h"
+#include "itf/options-itf.h"
+#include "util/work-stealing-scheduler.h"
+
+namespace kaldi {
+
+struct ExecutionOptions {
+  int32 intra_op_threads;
+  std::string cpu_affinity;
+
+  ExecutionOptions(): intra_op_threads(0), cpu_affinity("none") {}
+
+  void Register(OptionsItf *opts) {
+    opts->Register("intra-op-threads", &intra_op_threads,
+                   "Number of ATen intra-op threads of each worker thread; "
+                   "0 leaves it unchanged. The previous value is restored "
+                   "when the workers are done.");
+    opts->Register("cpu-affinity", &cpu_affinity,
+                   "Placement of the worker threads: \"none\", \"node\" (each "
+                   "worker is bound to the CPUs and memory of a NUMA node, "
+                   "round-robin) or \"cpu\" (each worker is bound to one CPU, "
+                   "spread over the NUMA nodes the same way).");
+  }
+};
+
+class ExecutionContext {
+ public:
+  explicit ExecutionContext(const ExecutionOptions &opts);
+
+  /// Restores the number of ATen intra-op threads, if it was set. Destroy the
+  /// context after the worker threads have finished.
+  ~ExecutionContext();
+
+  /// Makes the worker threads of `scheduler` call InitWorker().
+  void Configure(WorkStealingScheduler *scheduler) const;
+
+  /// Applies the options to the calling thread, as worker number `index`.
+  /// Failures are warned about, not thrown.
+  void InitWorker(int32 index) const;
+
+  /// The CPUs this process may run on, grouped by NUMA node; a single group
+  /// if the NUMA topology is not available.
+  const std::vector<std::vector<int32> > &Nodes() const { return nodes_; }
+
+ private:
+  ExecutionOptions opts_;
+  std::vector<std::vector<int32> > nodes_;
+  std::vector<int32> node_ids_;  // the NUMA node number of each of nodes_
+  int32 saved_intra_op_threads_;  // 0 if intra_op_threads is not set
+};
+
+} // namespace kaldi
+
+#endif
@@ -0,0 +1,270 @@
+// util/feature-cache.cc
+
+// Not in Kaldi.
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include "base/io-funcs.h"
+#include "util/feature-cache.h"
+
+namespace kaldi {
+
+namespace {
+
+const uint64 kPrime1 = 11400714785074694791ULL;
+const uint64 kPrime2 = 14029467366897019727ULL;
+const uint64 kPrime3 = 1609587929392839161ULL;
+const uint64 kPrime4 = 9650029242287828579ULL;
+const uint64 kPrime5 = 2870177450012600261ULL;
+
+inline uint64 Rotl(uint64 x, int r) { return (x << r) | (x >> (64 - r)); }
+
+inline uint64 Read64(const unsigned char *p) {
+  uint64 x;
+  std::memcpy(&x, p, sizeof(x));
+  return x;
+}
+
+inline uint32 Read32(const unsigned char *p) {
+  uint32 x;
+  std::memcpy(&x, p, sizeof(x));
+  return x;
+}
+
+inline uint64 Round(uint64 acc, uint64 input) {
+  acc += input * kPrime2;
+  return Rotl(acc, 31) * kPrime1;
+}
+
+inline uint64 MergeRound(uint64 acc, uint64 val) {
+  acc ^= Round(0, val);
+  return acc * kPrime1 + kPrime4;
+}
+
+// The length of the header of an entry: the key, a space, the binary marker
+// "\0B", the token "FM " and the two sizes, each preceded by its size in bytes.
+const size_t kKeyLength = 16;
+const size_t kHeaderLength = kKeyLength + 1 + 2 + 3 + 2 * (1 + sizeof(int32));
+
+struct Entry {
+  std::string path;
+  int64 size;
+  int64 mtime_ns;  // st_mtim, since st_mtime only has 1 s resolution.
+};
+
+// Lists the entries in `dir`.
+std::vector<Entry> ListEntries(const std::string &dir) {
+  std::vector<Entry> entries;
+  DIR *d = opendir(dir.c_str());
+  if (d == NULL) return entries;
+  while (struct dirent *e = readdir(d)) {
+    std::string name(e->d_name);
+    if (name.size() != kKeyLength + 4 ||
+        name.compare(kKeyLength, 4, ".ark") != 0)
+      continue;
+    Entry entry;
+    entry.path = dir + "/" + name;
+    struct stat st;
+    if (stat(entry.path.c_str(), &st) != 0) continue;
+    entry.size = st.st_size;
+    entry.mtime_ns = static_cast<int64>(st.st_mtim.tv_sec) * 1000000000 +
+      st.st_mtim.tv_nsec;
+    entries.push_back(entry);
+  }
+  closedir(d);
+  return entries;
+}
+
+} // namespace
+
+uint64 HashBytes(const void *data, size_t length, uint64 seed) {
+  const unsigned char *p = static_cast<const unsigned char*>(data),
+    *end = p + length;
+  uint64 h;
+  if (length >= 32) {
+    uint64 v1 = seed + kPrime1 + kPrime2, v2 = seed + kPrime2,
+      v3 = seed, v4 = seed - kPrime1;
+    for (; p + 32 <= end; p += 32) {
+      v1 = Round(v1, Read64(p));
+      v2 = Round(v2, Read64(p + 8));
+      v3 = Round(v3, Read64(p + 16));
+      v4 = Round(v4, Read64(p + 24));
+    }
+    h = Rotl(v1, 1) + Rotl(v2, 7) + Rotl(v3, 12) + Rotl(v4, 18);
+    h = MergeRound(h, v1);
+    h = MergeRound(h, v2);
+    h = MergeRound(h, v3);
+    h = MergeRound(h, v4);
+  } else {
+    h = seed + kPrime5;
+  }
+  h += static_cast<uint64>(length);
+  for (; p + 8 <= end; p += 8) {
+    h ^= Round(0, Read64(p));
+    h = Rotl(h, 27) * kPrime1 + kPrime4;
+  }
+  if (p + 4 <= end) {
+    h ^= static_cast<uint64>(Read32(p)) * kPrime1;
+    h = Rotl(h, 23) * kPrime2 + kPrime3;
+    p += 4;
+  }
+  for (; p < end; p++) {
+    h ^= (*p) * kPrime5;
+    h = Rotl(h, 11) * kPrime1;
+  }
+  h ^= h >> 33;
+  h *= kPrime2;
+  h ^= h >> 29;
+  h *= kPrime3;
+  h ^= h >> 32;
+  return h;
+}
+
+FeatureCache::FeatureCache(const std::string &dir, int64 max_bytes)
+    : dir_(dir), max_bytes_(max_bytes), total_bytes_(0) {
+  if (mkdir(dir.c_str(), 0777) != 0 && errno != EEXIST)
+    KALDI_ERR << "Cannot create the cache directory " << dir << ": "
+              << strerror(errno);
+  for (const auto &entry : ListEntries(dir_))
+    total_bytes_ += entry.size;
+}
+
+std::string FeatureCache::Key(const VectorBase<BaseFloat> &wave,
+                              const std::string &options) {
+  uint64 seed = HashBytes(options.data(), options.size());
+  uint64 hash = HashBytes(wave.Data(), sizeof(BaseFloat) * wave.Dim(), seed);
+  char key[kKeyLength + 1];
+  snprintf(key, sizeof(key), "%016llx", static_cast<unsigned long long>(hash));
+  return key;
+}
+
+std::string FeatureCache::Path(const std::string &key) const {
+  return dir_ + "/" + key + ".ark";
+}
+
+bool FeatureCache::Lookup(const std::string &key, Matrix<BaseFloat> *feats) {
+  KALDI_ASSERT(key.size() == kKeyLength);
+  const std::string path = Path(key);
+  bool found = false;
+  int fd = open(path.c_str(), O_RDONLY);
+  struct stat st;
+  if (fd >= 0 && fstat(fd, &st) == 0 &&
+      static_cast<size_t>(st.st_size) >= kHeaderLength) {
+    const size_t size = st.st_size;
+    void *addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (addr != MAP_FAILED) {
+      const char *header = static_cast<const char*>(addr);
+      int32 rows, cols;
+      std::memcpy(&rows, header + kKeyLength + 7, sizeof(rows));
+      std::memcpy(&cols, header + kKeyLength + 12, sizeof(cols));
+      // A partially written or foreign file is treated as a miss.
+      if (std::memcmp(header, key.data(), kKeyLength) == 0 &&
+          std::memcmp(header + kKeyLength, " \0BFM \4", 7) == 0 &&
+          header[kKeyLength + 11] == 4 && rows >= 0 && cols >= 0 &&
+          size == kHeaderLength + sizeof(BaseFloat) *
+                  static_cast<size_t>(rows) * static_cast<size_t>(cols)) {
+        feats->SetExternalData(
+          reinterpret_cast<BaseFloat*>(static_cast<char*>(addr) + kHeaderLength),
+          rows, cols,
+          std::shared_ptr<void>(addr, [size](void *p) { munmap(p, size); }));
+        found = true;
+      } else {
+        munmap(addr, size);
+      }
+    }
+  }
+  if (fd >= 0) close(fd);
+
+  if (found) {
+    // Mark the entry as recently used.
+    utimensat(AT_FDCWD, path.c_str(), NULL, 0);
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (found) {
+    stats_.num_hits++;
+    stats_.bytes_saved += sizeof(BaseFloat) * feats->NumRows() * feats->NumCols();
+  } else {
+    stats_.num_misses++;
+  }
+  return found;
+}
+
+void FeatureCache::Insert(const std::string &key,
+                          const MatrixBase<BaseFloat> &feats) {
+  KALDI_ASSERT(key.size() == kKeyLength);
+  // Write to a temporary file and rename it, so that readers never see a
+  // partial entry.
+  std::ostringstream tmp;
+  tmp << dir_ << "/." << key << ".tmp." << getpid() << "."
+      << std::hash<std::thread::id>()(std::this_thread::get_id());
+  const std::string tmp_path = tmp.str(), path = Path(key);
+  bool ok = false;
+  try {
+    std::ofstream os(tmp_path, std::ios::binary);
+    if (os.good()) {
+      os << key << ' ';
+      InitKaldiOutputStream(os, true);
+      feats.Write(os, true);
+      os.close();
+      ok = !os.fail();
+    }
+  } catch (const std::exception &e) {
+    ok = false;
+  }
+  if (!ok) {
+    KALDI_WARN << "Failed to write the cache entry " << tmp_path;
+    unlink(tmp_path.c_str());
+    return;
+  }
+  if (rename(tmp_path.c_str(), path.c_str()) != 0) {
+    KALDI_WARN << "Failed to write the cache entry " << path << ": "
+               << strerror(errno);
+    unlink(tmp_path.c_str());
+    return;
+  }
+
+  const int64 num_bytes = sizeof(BaseFloat) * feats.NumRows() * feats.NumCols();
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_.bytes_written += num_bytes;
+  total_bytes_ += kHeaderLength + num_bytes;
+  if (max_bytes_ > 0 && total_bytes_ > max_bytes_)
+    Evict();
+}
+
+void FeatureCache::Evict() {
+  std::vector<Entry> entries = ListEntries(dir_);
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry &a, const Entry &b) { return a.mtime_ns < b.mtime_ns; });
+  total_bytes_ = 0;
+  for (const auto &entry : entries)
+    total_bytes_ += entry.size;
+  // Go some way under the limit, so that the directory is not scanned on
+  // every insertion once the cache is full.
+  const int64 target = max_bytes_ - max_bytes_ / 10;
+  for (const auto &entry : entries) {
+    if (total_bytes_ <= target) break;
+    if (unlink(entry.path.c_str()) == 0) {
+      total_bytes_ -= entry.size;
+      stats_.num_evictions++;
+    }
+  }
+}
+
+FeatureCacheStats FeatureCache::Stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+} // namespace kaldi
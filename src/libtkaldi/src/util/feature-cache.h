@@ -0,0 +1,80 @@
+// util/feature-cache.h
+
+// Not in Kaldi.
+//
+// An on-disk cache of feature matrices, keyed by the content of the input
+// waveform and the options used to compute the features.
+//
+// Each entry is a file "<key>.ark" in the cache directory, holding a single
+// binary Kaldi archive entry "<key> \0BFM <rows> <cols> <data>", so the files
+// can be inspected with the usual tools (e.g. copy-feats ark:<file> ark,t:-).
+// With the 16 hexadecimal digit key the header is 32 bytes long, so the data
+// is aligned and a hit is served by mapping the file into memory, without
+// reading or copying it.
+//
+// The total size of the entries is kept under a limit by removing the least
+// recently used ones (by modification time, which is updated on hit), so the
+// directory can be shared by several processes.
+
+#ifndef KALDI_UTIL_FEATURE_CACHE_H_
+#define KALDI_UTIL_FEATURE_CACHE_H_
+
+#include <mutex>
+#include <string>
+#include "base/kaldi-common.h"
+#include "matrix/kaldi-matrix.h"
+
+namespace kaldi {
+
+/// 64-bit xxHash (XXH64) of `length` bytes at `data`.
+uint64 HashBytes(const void *data, size_t length, uint64 seed = 0);
+
+struct FeatureCacheStats {
+  int64 num_hits = 0;
+  int64 num_misses = 0;
+  int64 num_evictions = 0;
+  int64 bytes_saved = 0;     // feature bytes served from the cache
+  int64 bytes_written = 0;   // feature bytes added to the cache
+};
+
+class FeatureCache {
+ public:
+  /// Uses (and creates if needed) the directory `dir`. If max_bytes > 0, the
+  /// total size of the entries is kept under it.
+  FeatureCache(const std::string &dir, int64 max_bytes);
+
+  /// The key of the features of `wave` computed with options whose canonical
+  /// serialization is `options`; the same options must give the same string.
+  static std::string Key(const VectorBase<BaseFloat> &wave,
+                         const std::string &options);
+
+  /// If there is an entry for `key`, points `feats` to it (the memory is
+  /// mapped copy-on-write, so `feats` can be modified) and returns true.
+  bool Lookup(const std::string &key, Matrix<BaseFloat> *feats);
+
+  /// Adds an entry. Failures to write are only warned about.
+  void Insert(const std::string &key, const MatrixBase<BaseFloat> &feats);
+
+  FeatureCacheStats Stats() const;
+
+  const std::string &Dir() const { return dir_; }
+
+ private:
+  std::string Path(const std::string &key) const;
+
+  // Removes the least recently used entries until the total size is under
+  // the limit. Called with mutex_ held.
+  void Evict();
+
+  std::string dir_;
+  int64 max_bytes_;
+  int64 total_bytes_;  // estimate; re-scanned from the directory in Evict().
+  mutable std::mutex mutex_;
+  FeatureCacheStats stats_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(FeatureCache);
+};
+
+} // namespace kaldi
+
+#endif
@@ -0,0 +1,577 @@
+// util/npy-io.cc
+
+// Not in Kaldi.
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include "util/npy-io.h"
+
+namespace kaldi {
+
+namespace internal {
+
+struct MappedFile {
+  void *addr;
+  size_t size;
+
+  MappedFile(): addr(NULL), size(0) {}
+  ~MappedFile() { if (addr != NULL) munmap(addr, size); }
+
+  const char *Data() const { return static_cast<const char*>(addr); }
+};
+
+} // namespace internal
+
+namespace {
+
+using internal::MappedFile;
+
+// The data of each array starts at a multiple of this many bytes.
+const size_t kAlignment = 64;
+
+// Signatures of the ZIP records.
+const uint32 kLocalHeader = 0x04034b50;
+const uint32 kCentralHeader = 0x02014b50;
+const uint32 kEndOfCentralDirectory = 0x06054b50;
+const uint32 kZip64EndOfCentralDirectory = 0x06064b50;
+const uint32 kZip64Locator = 0x07064b50;
+const uint16 kZip64Extra = 0x0001;
+// The extra field used to pad local headers (the one zipalign uses).
+const uint16 kAlignmentExtra = 0xd935;
+// 1980-01-01, the earliest MS-DOS date.
+const uint16 kDosDate = (1 << 5) | 1;
+
+// Both NumPy's formats and ZIP are little-endian, as are the hosts we build
+// for, so values are read and written as they are in memory.
+template<typename T>
+T ReadLe(const char *p) {
+  T x;
+  std::memcpy(&x, p, sizeof(x));
+  return x;
+}
+
+template<typename T>
+void AppendLe(T x, std::string *s) {
+  s->append(reinterpret_cast<const char*>(&x), sizeof(x));
+}
+
+uint32 Crc32(const void *data, size_t length, uint32 crc) {
+  static const std::vector<uint32> table = []() {
+    std::vector<uint32> table(256);
+    for (uint32 i = 0; i < 256; i++) {
+      uint32 c = i;
+      for (int k = 0; k < 8; k++)
+        c = (c & 1) ? 0xedb88320U ^ (c >> 1) : c >> 1;
+      table[i] = c;
+    }
+    return table;
+  }();
+  const unsigned char *p = static_cast<const unsigned char*>(data);
+  crc = ~crc;
+  for (size_t i = 0; i < length; i++)
+    crc = table[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+  return ~crc;
+}
+
+std::shared_ptr<MappedFile> MapFile(const std::string &filename) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    KALDI_ERR << "Failed to open " << filename << ": " << strerror(errno);
+  std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    close(fd);
+    KALDI_ERR << "Failed to map " << filename << ": empty or unreadable file";
+  }
+  // Copy-on-write, so that the matrices can be modified.
+  void *addr = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                    fd, 0);
+  const int mmap_errno = errno;
+  close(fd);
+  if (addr == MAP_FAILED)
+    KALDI_ERR << "Failed to map " << filename << ": " << strerror(mmap_errno);
+  file->addr = addr;
+  file->size = st.st_size;
+  return file;
+}
+
+struct NpyArray {
+  size_t data_offset;  // from the start of the header
+  int64 num_rows;
+  int64 num_cols;
+  bool is_double;
+
+  size_t NumBytes() const {
+    return static_cast<size_t>(num_rows) * num_cols * (is_double ? 8 : 4);
+  }
+};
+
+// The value of `key` in the header dictionary `dict`, up to the next ',' or
+// '}' (or the closing ')' of a tuple).
+bool FindHeaderValue(const std::string &dict, const std::string &key,
+                     std::string *value) {
+  size_t pos = dict.find("'" + key + "'");
+  if (pos == std::string::npos) return false;
+  pos = dict.find(':', pos);
+  if (pos == std::string::npos) return false;
+  pos = dict.find_first_not_of(' ', pos + 1);
+  if (pos == std::string::npos) return false;
+  const size_t end = dict[pos] == '(' ? dict.find(')', pos) + 1
+                                      : dict.find_first_of(",}", pos);
+  if (end == std::string::npos || end == 0) return false;
+  *value = dict.substr(pos, end - pos);
+  return true;
+}
+
+// Parses the header of the .npy data of `size` bytes at `data`. Returns
+// false, after setting `error`, if it is not a 2-D float32 or float64 array
+// in C order.
+bool ParseNpyHeader(const char *data, size_t size, NpyArray *array,
+                    std::string *error) {
+  if (size < 10 || std::memcmp(data, "\x93NUMPY", 6) != 0) {
+    *error = "not a .npy file";
+    return false;
+  }
+  size_t header_length, header_begin;
+  if (data[6] == 1) {
+    header_length = ReadLe<uint16>(data + 8);
+    header_begin = 10;
+  } else if ((data[6] == 2 || data[6] == 3) && size >= 12) {
+    header_length = ReadLe<uint32>(data + 8);
+    header_begin = 12;
+  } else {
+    *error = "unsupported .npy version";
+    return false;
+  }
+  if (header_begin + header_length > size) {
+    *error = "truncated header";
+    return false;
+  }
+  const std::string dict(data + header_begin, header_length);
+  std::string descr, fortran_order, shape;
+  if (!FindHeaderValue(dict, "descr", &descr) ||
+      !FindHeaderValue(dict, "fortran_order", &fortran_order) ||
+      !FindHeaderValue(dict, "shape", &shape)) {
+    *error = "malformed header " + dict;
+    return false;
+  }
+  if (descr == "'<f4'") {
+    array->is_double = false;
+  } else if (descr == "'<f8'") {
+    array->is_double = true;
+  } else {
+    *error = "unsupported dtype " + descr + " (expected <f4 or <f8)";
+    return false;
+  }
+  if (fortran_order != "False") {
+    *error = "arrays in Fortran order are not supported";
+    return false;
+  }
+  std::vector<int64> dims;
+  std::istringstream is(shape.substr(1));
+  int64 dim;
+  char separator;
+  while (is >> dim) {
+    dims.push_back(dim);
+    if (!(is >> separator) || separator != ',') break;
+  }
+  if (dims.size() != 2 || dims[0] < 0 || dims[1] < 0 ||
+      dims[0] > std::numeric_limits<int32>::max() ||
+      dims[1] > std::numeric_limits<int32>::max()) {
+    *error = "expected a matrix, got shape " + shape;
+    return false;
+  }
+  array->num_rows = dims[0];
+  array->num_cols = dims[1];
+  array->data_offset = header_begin + header_length;
+  if (array->data_offset + array->NumBytes() > size) {
+    *error = "truncated data";
+    return false;
+  }
+  return true;
+}
+
+// The .npy header of a [num_rows, num_cols] float32 array, padded with spaces
+// to at least `min_length` bytes and to a multiple of kAlignment.
+std::string NpyHeader(int64 num_rows, int64 num_cols, size_t min_length) {
+  std::ostringstream dict;
+  dict << "{'descr': '<f4', 'fortran_order': False, 'shape': ("
+       << num_rows << ", " << num_cols << "), }";
+  const size_t prefix_length = 10;
+  size_t length = std::max(prefix_length + dict.str().size() + 1, min_length);
+  length = (length + kAlignment - 1) / kAlignment * kAlignment;
+  std::string header("\x93NUMPY\x01\x00", 8);
+  AppendLe<uint16>(length - prefix_length, &header);
+  header += dict.str();
+  header.append(length - header.size() - 1, ' ');
+  header += '\n';
+  return header;
+}
+
+// Points `value` to the matrix at `data` in `file`, or copies it if it can
+// not be used as it is.
+void MapArray(const std::shared_ptr<MappedFile> &file, const char *data,
+              int32 num_rows, int32 num_cols, bool is_double,
+              Matrix<BaseFloat> *value) {
+  char *ptr = const_cast<char*>(data);
+  const size_t size = static_cast<size_t>(num_rows) * num_cols;
+  if (!is_double &&
+      reinterpret_cast<uintptr_t>(ptr) % sizeof(BaseFloat) == 0) {
+    value->SetExternalData(reinterpret_cast<BaseFloat*>(ptr), num_rows,
+                           num_cols, file);
+    return;
+  }
+  // New storage, as the current one may be mapped.
+  Matrix<BaseFloat> copy(num_rows, num_cols, kUndefined);
+  if (is_double) {
+    Matrix<double> array(num_rows, num_cols, kUndefined);
+    std::memcpy(array.Data(), ptr, size * sizeof(double));
+    copy.CopyFromMat(array);
+  } else {
+    std::memcpy(copy.Data(), ptr, size * sizeof(BaseFloat));
+  }
+  value->Swap(&copy);
+}
+
+// Writes the rows of `value` to `os`, without copying them. Returns the
+// number of bytes written.
+size_t WriteRows(const MatrixBase<BaseFloat> &value, std::ostream &os) {
+  KALDI_ASSERT(value.HasContiguousRows());
+  const size_t row_bytes = sizeof(BaseFloat) * value.NumCols();
+  if (value.Stride() == value.NumCols() || value.NumRows() <= 1) {
+    os.write(reinterpret_cast<const char*>(value.Data()),
+             row_bytes * value.NumRows());
+  } else {
+    for (MatrixIndexT r = 0; r < value.NumRows(); r++)
+      os.write(reinterpret_cast<const char*>(
+                 value.Data() + static_cast<size_t>(r) * value.Stride()),
+               row_bytes);
+  }
+  return row_bytes * value.NumRows();
+}
+
+} // namespace
+
+void ReadNpy(const std::string &filename, Matrix<BaseFloat> *value) {
+  std::shared_ptr<MappedFile> file = MapFile(filename);
+  NpyArray array;
+  std::string error;
+  if (!ParseNpyHeader(file->Data(), file->size, &array, &error))
+    KALDI_ERR << "Failed to read " << filename << ": " << error;
+  MapArray(file, file->Data() + array.data_offset, array.num_rows,
+           array.num_cols, array.is_double, value);
+}
+
+void WriteNpy(const std::string &filename, const MatrixBase<BaseFloat> &value) {
+  std::ofstream os(filename, std::ios::binary);
+  const std::string header = NpyHeader(value.NumRows(), value.NumCols(), 0);
+  os.write(header.data(), header.size());
+  WriteRows(value, os);
+  os.close();
+  if (os.fail())
+    KALDI_ERR << "Failed to write " << filename;
+}
+
+NpyArchiveReader::NpyArchiveReader(const std::string &filename, bool is_npz)
+    : filename_(filename), file_(MapFile(filename)) {
+  if (is_npz)
+    ReadNpz();
+  else
+    ReadCorpus(filename + ".index");
+}
+
+int32 NpyArchiveReader::Find(const std::string &key) const {
+  auto it = index_.find(key);
+  return it == index_.end() ? -1 : it->second;
+}
+
+void NpyArchiveReader::Value(int32 i, Matrix<BaseFloat> *value) const {
+  KALDI_ASSERT(i >= 0 && i < NumEntries());
+  const Entry &entry = entries_[i];
+  MapArray(file_, file_->Data() + entry.offset, entry.num_rows,
+           entry.num_cols, entry.is_double, value);
+}
+
+void NpyArchiveReader::AddEntry(const Entry &entry) {
+  // As in Kaldi's tables, the first of duplicate keys is used.
+  if (index_.emplace(entry.key, entries_.size()).second)
+    entries_.push_back(entry);
+}
+
+void NpyArchiveReader::ReadNpz() {
+  const char *data = file_->Data();
+  const size_t size = file_->size;
+  auto check = [&](uint64 begin, uint64 length) {
+    if (begin > size || length > size - begin)
+      KALDI_ERR << "Failed to read " << filename_ << ": truncated archive";
+  };
+
+  // The end of central directory record is followed by a comment of at most
+  // 65535 bytes.
+  const size_t eocd_length = 22;
+  check(0, eocd_length);
+  size_t eocd = size - eocd_length;
+  const size_t eocd_min = eocd > 0xffff ? eocd - 0xffff : 0;
+  while (ReadLe<uint32>(data + eocd) != kEndOfCentralDirectory) {
+    if (eocd == eocd_min)
+      KALDI_ERR << "Failed to read " << filename_ << ": not a .npz archive";
+    eocd--;
+  }
+  uint64 num_entries = ReadLe<uint16>(data + eocd + 10);
+  uint64 directory_offset = ReadLe<uint32>(data + eocd + 16);
+  if (num_entries == 0xffff || directory_offset == 0xffffffff) {
+    const size_t locator_length = 20, eocd64_length = 56;
+    if (eocd >= locator_length &&
+        ReadLe<uint32>(data + eocd - locator_length) == kZip64Locator) {
+      const uint64 eocd64 = ReadLe<uint64>(data + eocd - locator_length + 8);
+      check(eocd64, eocd64_length);
+      if (ReadLe<uint32>(data + eocd64) != kZip64EndOfCentralDirectory)
+        KALDI_ERR << "Failed to read " << filename_ << ": bad ZIP64 record";
+      num_entries = ReadLe<uint64>(data + eocd64 + 32);
+      directory_offset = ReadLe<uint64>(data + eocd64 + 48);
+    }
+  }
+
+  uint64 pos = directory_offset;
+  for (uint64 i = 0; i < num_entries; i++) {
+    const size_t central_length = 46;
+    check(pos, central_length);
+    const char *header = data + pos;
+    if (ReadLe<uint32>(header) != kCentralHeader)
+      KALDI_ERR << "Failed to read " << filename_ << ": bad central directory";
+    const uint16 method = ReadLe<uint16>(header + 10);
+    uint64 compressed_size = ReadLe<uint32>(header + 20);
+    uint64 entry_size = ReadLe<uint32>(header + 24);
+    const uint16 name_length = ReadLe<uint16>(header + 28),
+        extra_length = ReadLe<uint16>(header + 30),
+        comment_length = ReadLe<uint16>(header + 32);
+    uint64 local_offset = ReadLe<uint32>(header + 42);
+    check(pos + central_length, name_length + extra_length);
+    const std::string name(header + central_length, name_length);
+    // The sizes and offset which do not fit in 32 bits are in the ZIP64
+    // extra field, in this order.
+    const char *extra = header + central_length + name_length;
+    for (size_t e = 0; e + 4 <= extra_length;) {
+      const uint16 id = ReadLe<uint16>(extra + e),
+          length = ReadLe<uint16>(extra + e + 2);
+      if (id == kZip64Extra) {
+        size_t f = e + 4;
+        for (uint64 *field : {&entry_size, &compressed_size, &local_offset}) {
+          if (*field == 0xffffffff && f + 8 <= e + 4 + length) {
+            *field = ReadLe<uint64>(extra + f);
+            f += 8;
+          }
+        }
+      }
+      e += 4 + length;
+    }
+    pos += central_length + name_length + extra_length + comment_length;
+
+    const std::string suffix = ".npy";
+    if (name.size() < suffix.size() ||
+        name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0) {
+      KALDI_WARN << "Ignoring " << name << " in " << filename_
+                 << ": not a .npy file";
+      continue;
+    }
+    if (method != 0)
+      KALDI_ERR << "Failed to read " << filename_ << ": " << name
+                << " is compressed (use numpy.savez, not savez_compressed)";
+    const size_t local_length = 30;
+    check(local_offset, local_length);
+    const char *local = data + local_offset;
+    if (ReadLe<uint32>(local) != kLocalHeader)
+      KALDI_ERR << "Failed to read " << filename_ << ": bad local header";
+    const uint64 begin = local_offset + local_length +
+        ReadLe<uint16>(local + 26) + ReadLe<uint16>(local + 28);
+    check(begin, entry_size);
+    NpyArray array;
+    std::string error;
+    if (!ParseNpyHeader(data + begin, entry_size, &array, &error))
+      KALDI_ERR << "Failed to read " << name << " in " << filename_ << ": "
+                << error;
+    Entry entry;
+    entry.key = name.substr(0, name.size() - suffix.size());
+    entry.offset = begin + array.data_offset;
+    entry.num_rows = array.num_rows;
+    entry.num_cols = array.num_cols;
+    entry.is_double = array.is_double;
+    AddEntry(entry);
+  }
+}
+
+void NpyArchiveReader::ReadCorpus(const std::string &index_filename) {
+  NpyArray array;
+  std::string error;
+  if (!ParseNpyHeader(file_->Data(), file_->size, &array, &error))
+    KALDI_ERR << "Failed to read " << filename_ << ": " << error;
+  std::ifstream is(index_filename);
+  if (!is.good())
+    KALDI_ERR << "Failed to open the index " << index_filename;
+  const size_t row_bytes = array.num_cols * (array.is_double ? 8 : 4);
+  std::string line;
+  while (std::getline(is, line)) {
+    std::istringstream fields(line);
+    Entry entry;
+    int64 first_row, num_rows;
+    if (!(fields >> entry.key >> first_row >> num_rows) || first_row < 0 ||
+        num_rows < 0 || first_row + num_rows > array.num_rows)
+      KALDI_ERR << "Bad line in " << index_filename << ": " << line;
+    entry.offset = array.data_offset + first_row * row_bytes;
+    entry.num_rows = num_rows;
+    entry.num_cols = array.num_cols;
+    entry.is_double = array.is_double;
+    AddEntry(entry);
+  }
+}
+
+NpyArchiveWriter::NpyArchiveWriter(const std::string &filename, bool is_npz)
+    : filename_(filename), is_npz_(is_npz),
+      os_(filename, std::ios::binary), offset_(0),
+      header_length_(0), num_rows_(0), num_cols_(0) {
+  if (!os_.good())
+    KALDI_ERR << "Failed to open " << filename << " for writing";
+  if (!is_npz_) {
+    index_os_.open(filename + ".index");
+    if (!index_os_.good())
+      KALDI_ERR << "Failed to open " << filename << ".index for writing";
+    // Room for the header of any shape, which is rewritten by Close().
+    header_length_ = NpyHeader(std::numeric_limits<int64>::max(),
+                               std::numeric_limits<int32>::max(), 0).size();
+    const std::string header = NpyHeader(0, 0, header_length_);
+    os_.write(header.data(), header.size());
+    offset_ = header.size();
+  }
+}
+
+NpyArchiveWriter::~NpyArchiveWriter() {
+  if (os_.is_open()) {
+    try {
+      Close();
+    } catch (const std::exception &e) {
+      KALDI_WARN << "Failed to close " << filename_;
+    }
+  }
+}
+
+void NpyArchiveWriter::Write(const std::string &key,
+                             const MatrixBase<BaseFloat> &value) {
+  KALDI_ASSERT(os_.is_open());
+  if (!is_npz_) {
+    if (num_rows_ == 0 && num_cols_ == 0)
+      num_cols_ = value.NumCols();
+    if (value.NumCols() != num_cols_)
+      KALDI_ERR << "Writing a matrix with " << value.NumCols() << " columns "
+                << "for key " << key << " to " << filename_ << ", which has "
+                << num_cols_;
+    index_os_ << key << ' ' << num_rows_ << ' ' << value.NumRows() << '\n';
+    num_rows_ += value.NumRows();
+    offset_ += WriteRows(value, os_);
+  } else {
+    ZipEntry entry;
+    entry.name = key + ".npy";
+    entry.offset = offset_;
+    const std::string header = NpyHeader(value.NumRows(), value.NumCols(), 0);
+    entry.size = header.size() +
+        sizeof(BaseFloat) * value.NumRows() * value.NumCols();
+    entry.crc = Crc32(header.data(), header.size(), 0);
+    for (MatrixIndexT r = 0; r < value.NumRows(); r++)
+      entry.crc = Crc32(value.Data() + static_cast<size_t>(r) * value.Stride(),
+                        sizeof(BaseFloat) * value.NumCols(), entry.crc);
+
+    // Pad the local header, so that the data starts at a multiple of
+    // kAlignment (the .npy header being a multiple of it too).
+    const size_t local_length = 30;
+    size_t padding = (kAlignment - (offset_ + local_length +
+                                    entry.name.size()) % kAlignment) % kAlignment;
+    if (padding > 0 && padding < 4) padding += kAlignment;
+    if (entry.offset + local_length + entry.name.size() + padding +
+        entry.size >= 0xffffffff || zip_entries_.size() >= 0xffff)
+      KALDI_ERR << "Writing " << filename_ << ": .npz archives over 4 GiB or "
+                << "65535 entries are not supported; use npy: instead.";
+    std::string local;
+    AppendLe<uint32>(kLocalHeader, &local);
+    AppendLe<uint16>(20, &local);  // version needed to extract
+    AppendLe<uint16>(0, &local);   // flags
+    AppendLe<uint16>(0, &local);   // method: stored
+    AppendLe<uint16>(0, &local);   // time
+    AppendLe<uint16>(kDosDate, &local);
+    AppendLe<uint32>(entry.crc, &local);
+    AppendLe<uint32>(entry.size, &local);  // compressed size
+    AppendLe<uint32>(entry.size, &local);
+    AppendLe<uint16>(entry.name.size(), &local);
+    AppendLe<uint16>(padding, &local);
+    local += entry.name;
+    if (padding > 0) {
+      AppendLe<uint16>(kAlignmentExtra, &local);
+      AppendLe<uint16>(padding - 4, &local);
+      local.append(padding - 4, '\0');
+    }
+    local += header;
+    os_.write(local.data(), local.size());
+    offset_ += local.size();
+    offset_ += WriteRows(value, os_);
+    zip_entries_.push_back(entry);
+  }
+  if (!os_.good())
+    KALDI_ERR << "Failed to write to " << filename_;
+}
+
+void NpyArchiveWriter::Close() {
+  if (!os_.is_open()) return;
+  if (!is_npz_) {
+    const std::string header = NpyHeader(num_rows_, num_cols_, header_length_);
+    KALDI_ASSERT(header.size() == header_length_);
+    os_.seekp(0);
+    os_.write(header.data(), header.size());
+    index_os_.close();
+    if (index_os_.fail())
+      KALDI_ERR << "Failed to write " << filename_ << ".index";
+  } else {
+    std::string directory;
+    for (const ZipEntry &entry : zip_entries_) {
+      AppendLe<uint32>(kCentralHeader, &directory);
+      AppendLe<uint16>(20, &directory);  // version made by
+      AppendLe<uint16>(20, &directory);  // version needed to extract
+      AppendLe<uint16>(0, &directory);   // flags
+      AppendLe<uint16>(0, &directory);   // method: stored
+      AppendLe<uint16>(0, &directory);   // time
+      AppendLe<uint16>(kDosDate, &directory);
+      AppendLe<uint32>(entry.crc, &directory);
+      AppendLe<uint32>(entry.size, &directory);  // compressed size
+      AppendLe<uint32>(entry.size, &directory);
+      AppendLe<uint16>(entry.name.size(), &directory);
+      AppendLe<uint16>(0, &directory);  // extra field length
+      AppendLe<uint16>(0, &directory);  // comment length
+      AppendLe<uint16>(0, &directory);  // disk number
+      AppendLe<uint16>(0, &directory);  // internal attributes
+      AppendLe<uint32>(0, &directory);  // external attributes
+      AppendLe<uint32>(entry.offset, &directory);
+      directory += entry.name;
+    }
+    const size_t directory_size = directory.size();
+    AppendLe<uint32>(kEndOfCentralDirectory, &directory);
+    AppendLe<uint16>(0, &directory);  // disk number
+    AppendLe<uint16>(0, &directory);  // disk of the central directory
+    AppendLe<uint16>(zip_entries_.size(), &directory);
+    AppendLe<uint16>(zip_entries_.size(), &directory);
+    AppendLe<uint32>(directory_size, &directory);
+    AppendLe<uint32>(offset_, &directory);
+    AppendLe<uint16>(0, &directory);  // comment length
+    os_.write(directory.data(), directory.size());
+    offset_ += directory.size();
+  }
+  os_.close();
+  if (os_.fail())
+    KALDI_ERR << "Failed to write " << filename_;
+}
+
+} // namespace kaldi
@@ -0,0 +1,130 @@
+// util/npy-io.h
+
+// Not in Kaldi.
+//
+// Reading and writing feature matrices in NumPy's file formats.
+//
+// matrix/numpy-array.h (copied from Kaldi) reads a .npy file through a
+// stream into memory it allocates. The readers here map the file into memory
+// instead: the tensor of the Matrix points to the mapping (copy-on-write, so
+// it can be modified without changing the file), and nothing is read or
+// copied until it is used. The writers lay the files out for this: the
+// header of each array is padded so that its data starts at a multiple of 64
+// bytes of the file, and the rows are written straight from the matrix.
+//
+// Three layouts are supported:
+//  - a single .npy file, holding a 2-D array;
+//  - a .npz archive, as written by numpy.savez, holding one "<key>.npy"
+//    entry per matrix; and
+//  - a corpus .npy, holding the rows of all the matrices one after the
+//    other, with a side index "<file>.index" of lines
+//    "<key> <first-row> <num-rows>". numpy.load(file, mmap_mode='r') loads
+//    it the same way, and the matrix of a key is a slice of it.
+//
+// Little-endian, C-ordered float32 arrays are mapped; float64 arrays
+// (NumPy's default dtype) are converted as they are read. Compressed .npz
+// entries (numpy.savez_compressed) are not supported. ZIP64 archives can be
+// read, but the writer does not produce them, so a .npz written here is
+// limited to 4 GiB; use a corpus .npy for larger sets.
+
+#ifndef KALDI_UTIL_NPY_IO_H_
+#define KALDI_UTIL_NPY_IO_H_
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "base/kaldi-common.h"
+#include "matrix/kaldi-matrix.h"
+
+namespace kaldi {
+
+namespace internal {
+struct MappedFile;
+}
+
+/// Points `value` to the 2-D array of the .npy file `filename`.
+void ReadNpy(const std::string &filename, Matrix<BaseFloat> *value);
+
+/// Writes `value` to the .npy file `filename`.
+void WriteNpy(const std::string &filename, const MatrixBase<BaseFloat> &value);
+
+/// The matrices of a .npz archive or of a corpus .npy, by key. The file is
+/// mapped once; finding a key and getting its matrix take constant time.
+class NpyArchiveReader {
+ public:
+  /// If is_npz is false, `filename` is a corpus .npy and its index is read
+  /// from filename + ".index".
+  NpyArchiveReader(const std::string &filename, bool is_npz);
+
+  int32 NumEntries() const { return entries_.size(); }
+
+  const std::string &Key(int32 i) const { return entries_[i].key; }
+
+  /// The index of the entry `key`, or -1 if there is none.
+  int32 Find(const std::string &key) const;
+
+  /// Points `value` to the matrix of entry i. Matrices of the same entry
+  /// share their memory. Entries which cannot be mapped (float64, or not
+  /// aligned, as numpy.savez writes them) are copied.
+  void Value(int32 i, Matrix<BaseFloat> *value) const;
+
+ private:
+  struct Entry {
+    std::string key;
+    size_t offset;  // of the data, in the file
+    int32 num_rows;
+    int32 num_cols;
+    bool is_double;
+  };
+
+  void ReadNpz();
+  void ReadCorpus(const std::string &index_filename);
+  void AddEntry(const Entry &entry);
+
+  std::string filename_;
+  std::shared_ptr<internal::MappedFile> file_;
+  std::vector<Entry> entries_;
+  std::unordered_map<std::string, int32> index_;
+};
+
+/// Writes matrices to a .npz archive or a corpus .npy. The file is complete
+/// once Close() has been called (the destructor calls it).
+class NpyArchiveWriter {
+ public:
+  NpyArchiveWriter(const std::string &filename, bool is_npz);
+
+  ~NpyArchiveWriter();
+
+  /// In a corpus .npy, all the matrices must have the same number of columns.
+  void Write(const std::string &key, const MatrixBase<BaseFloat> &value);
+
+  void Close();
+
+ private:
+  struct ZipEntry {
+    std::string name;
+    uint32 crc;
+    uint64 size;
+    uint64 offset;  // of the local header
+  };
+
+  std::string filename_;
+  bool is_npz_;
+  std::ofstream os_;
+  uint64 offset_;  // the number of bytes written to os_
+
+  // .npz
+  std::vector<ZipEntry> zip_entries_;
+
+  // corpus .npy
+  std::ofstream index_os_;
+  size_t header_length_;
+  int64 num_rows_;
+  int32 num_cols_;
+};
+
+} // namespace kaldi
+
+#endif
@@ -0,0 +1,108 @@
+// util/npy-table.cc
+
+// Not in Kaldi.
+
+#include "util/npy-table.h"
+
+namespace kaldi {
+
+bool ClassifyNpySpecifier(const std::string &specifier, std::string *filename,
+                          bool *is_npz) {
+  const bool npz = specifier.compare(0, 4, "npz:") == 0;
+  if (!npz && specifier.compare(0, 4, "npy:") != 0)
+    return false;
+  if (filename != NULL) *filename = specifier.substr(4);
+  if (is_npz != NULL) *is_npz = npz;
+  return true;
+}
+
+FeatureMatrixWriter::FeatureMatrixWriter(const std::string &wspecifier) {
+  std::string filename;
+  bool is_npz;
+  if (ClassifyNpySpecifier(wspecifier, &filename, &is_npz))
+    npy_writer_.reset(new NpyArchiveWriter(filename, is_npz));
+  else
+    table_writer_.reset(new BaseFloatMatrixWriter(wspecifier));
+}
+
+void FeatureMatrixWriter::Write(const std::string &key,
+                                const MatrixBase<BaseFloat> &value) {
+  if (npy_writer_)
+    npy_writer_->Write(key, value);
+  else
+    table_writer_->Write(key, value);
+}
+
+bool FeatureMatrixWriter::Close() {
+  if (!npy_writer_)
+    return table_writer_->Close();
+  try {
+    npy_writer_->Close();
+    return true;
+  } catch (const std::exception &e) {
+    KALDI_WARN << e.what();
+    return false;
+  }
+}
+
+SequentialFeatureMatrixReader::SequentialFeatureMatrixReader(
+    const std::string &rspecifier): index_(0) {
+  std::string filename;
+  bool is_npz;
+  if (ClassifyNpySpecifier(rspecifier, &filename, &is_npz))
+    npy_reader_.reset(new NpyArchiveReader(filename, is_npz));
+  else
+    table_reader_.reset(new SequentialBaseFloatMatrixReader(rspecifier));
+}
+
+bool SequentialFeatureMatrixReader::Done() {
+  if (table_reader_) return table_reader_->Done();
+  return index_ >= npy_reader_->NumEntries();
+}
+
+std::string SequentialFeatureMatrixReader::Key() {
+  if (table_reader_) return table_reader_->Key();
+  KALDI_ASSERT(!Done());
+  return npy_reader_->Key(index_);
+}
+
+const Matrix<BaseFloat> &SequentialFeatureMatrixReader::Value() {
+  if (table_reader_) return table_reader_->Value();
+  KALDI_ASSERT(!Done());
+  npy_reader_->Value(index_, &value_);
+  return value_;
+}
+
+void SequentialFeatureMatrixReader::Next() {
+  if (table_reader_)
+    table_reader_->Next();
+  else
+    index_++;
+}
+
+RandomAccessFeatureMatrixReader::RandomAccessFeatureMatrixReader(
+    const std::string &rspecifier) {
+  std::string filename;
+  bool is_npz;
+  if (ClassifyNpySpecifier(rspecifier, &filename, &is_npz))
+    npy_reader_.reset(new NpyArchiveReader(filename, is_npz));
+  else
+    table_reader_.reset(new RandomAccessBaseFloatMatrixReader(rspecifier));
+}
+
+bool RandomAccessFeatureMatrixReader::HasKey(const std::string &key) {
+  if (table_reader_) return table_reader_->HasKey(key);
+  return npy_reader_->Find(key) >= 0;
+}
+
+const Matrix<BaseFloat> &RandomAccessFeatureMatrixReader::Value(
+    const std::string &key) {
+  if (table_reader_) return table_reader_->Value(key);
+  const int32 index = npy_reader_->Find(key);
+  if (index < 0)
+    KALDI_ERR << "Value() called for non-existent key " << key;
+  npy_reader_->Value(index, &value_);
+  return value_;
+}
+
+} // namespace kaldi
@@ -0,0 +1,82 @@
+// util/npy-table.h
+
+// Not in Kaldi.
+//
+// Readers and writers of feature matrices which accept, besides Kaldi's
+// rspecifiers and wspecifiers, "npz:<file>" (a .npz archive) and
+// "npy:<file>" (a corpus .npy with the index <file>.index); see
+// util/npy-io.h. The feature binaries use them in place of
+// SequentialBaseFloatMatrixReader, RandomAccessBaseFloatMatrixReader and
+// BaseFloatMatrixWriter, with the same interface.
+//
+// Kaldi's table code (util/kaldi-table.h) is unchanged, so its options (e.g.
+// "ark,scp:" or "p,") do not apply to the NumPy specifiers.
+
+#ifndef KALDI_UTIL_NPY_TABLE_H_
+#define KALDI_UTIL_NPY_TABLE_H_
+
+#include <memory>
+#include <string>
+#include "util/npy-io.h"
+#include "util/table-types.h"
+
+namespace kaldi {
+
+/// If `specifier` is "npz:<file>" or "npy:<file>", sets `filename` and
+/// `is_npz` (either may be NULL) and returns true.
+bool ClassifyNpySpecifier(const std::string &specifier, std::string *filename,
+                          bool *is_npz);
+
+class FeatureMatrixWriter {
+ public:
+  explicit FeatureMatrixWriter(const std::string &wspecifier);
+
+  void Write(const std::string &key, const MatrixBase<BaseFloat> &value);
+
+  /// Returns false on error; errors after the last Write() are otherwise
+  /// only reported when this is destroyed.
+  bool Close();
+
+ private:
+  std::unique_ptr<BaseFloatMatrixWriter> table_writer_;
+  std::unique_ptr<NpyArchiveWriter> npy_writer_;
+};
+
+class SequentialFeatureMatrixReader {
+ public:
+  explicit SequentialFeatureMatrixReader(const std::string &rspecifier);
+
+  bool Done();
+
+  std::string Key();
+
+  /// Valid until the next call to Next().
+  const Matrix<BaseFloat> &Value();
+
+  void Next();
+
+ private:
+  std::unique_ptr<SequentialBaseFloatMatrixReader> table_reader_;
+  std::unique_ptr<NpyArchiveReader> npy_reader_;
+  int32 index_;
+  Matrix<BaseFloat> value_;
+};
+
+class RandomAccessFeatureMatrixReader {
+ public:
+  explicit RandomAccessFeatureMatrixReader(const std::string &rspecifier);
+
+  bool HasKey(const std::string &key);
+
+  /// Valid until the next call to Value().
+  const Matrix<BaseFloat> &Value(const std::string &key);
+
+ private:
+  std::unique_ptr<RandomAccessBaseFloatMatrixReader> table_reader_;
+  std::unique_ptr<NpyArchiveReader> npy_reader_;
+  Matrix<BaseFloat> value_;
+};
+
+} // namespace kaldi
+
+#endif
@@ -0,0 +1,72 @@
+// util/task-pool.cc
+
+// Not in Kaldi.
+
+#include "util/task-pool.h"
+
+namespace kaldi {
+
+TaskPool::TaskPool(int32 num_threads, int32 max_pending)
+    : max_pending_(max_pending), num_running_(0), stopping_(false) {
+  if (num_threads < 1 || max_pending < 1)
+    KALDI_ERR << "Invalid task pool size: " << num_threads << " threads, "
+              << max_pending << " pending tasks.";
+  for (int32 i = 0; i < num_threads; i++)
+    workers_.emplace_back(&TaskPool::Work, this);
+}
+
+TaskPool::~TaskPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  not_empty_.notify_all();
+  for (auto &worker : workers_)
+    worker.join();
+}
+
+void TaskPool::Submit(Task task) {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_full_.wait(lock, [this]() {
+      return static_cast<int32>(queue_.size()) < max_pending_;
+    });
+    queue_.push_back(std::move(task));
+  }
+  not_empty_.notify_one();
+}
+
+bool TaskPool::TrySubmit(Task task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (static_cast<int32>(queue_.size()) >= max_pending_) return false;
+    queue_.push_back(std::move(task));
+  }
+  not_empty_.notify_one();
+  return true;
+}
+
+int32 TaskPool::NumPending() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return queue_.size() + num_running_;
+}
+
+void TaskPool::Work() {
+  while (true) {
+    Task task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      not_empty_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+      if (queue_.empty()) return;  // stopping, and nothing left to run
+      task = std::move(queue_.front());
+      queue_.pop_front();
+      num_running_++;
+    }
+    not_full_.notify_one();
+    task();
+    std::lock_guard<std::mutex> lock(mutex_);
+    num_running_--;
+  }
+}
+
+} // namespace kaldi
@@ -0,0 +1,65 @@
+// util/task-pool.h
+
+// Not in Kaldi.
+//
+// A fixed set of worker threads running tasks from a bounded queue, for
+// requests that arrive one at a time (e.g. from a serving loop) rather than
+// as a batch. When `max_pending` tasks are waiting, Submit() blocks until a
+// worker takes one, so a producer which is faster than the workers is slowed
+// down instead of queueing an unbounded amount of input.
+
+#ifndef KALDI_UTIL_TASK_POOL_H_
+#define KALDI_UTIL_TASK_POOL_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "base/kaldi-common.h"
+
+namespace kaldi {
+
+class TaskPool {
+ public:
+  typedef std::function<void()> Task;
+
+  /// Starts `num_threads` workers. At most `max_pending` tasks wait in the
+  /// queue, not counting the ones being run.
+  TaskPool(int32 num_threads, int32 max_pending);
+
+  /// Runs the tasks already queued, and joins the workers.
+  ~TaskPool();
+
+  /// Queues a task, waiting while the queue is full. Tasks must not throw;
+  /// they report errors through whatever they compute into.
+  void Submit(Task task);
+
+  /// Same as Submit(), but returns false instead of waiting if the queue is
+  /// full.
+  bool TrySubmit(Task task);
+
+  int32 NumThreads() const { return workers_.size(); }
+
+  /// The number of tasks queued or running.
+  int32 NumPending() const;
+
+ private:
+  void Work();
+
+  int32 max_pending_;
+  mutable std::mutex mutex_;
+  std::condition_variable not_empty_;
+  std::condition_variable not_full_;
+  std::deque<Task> queue_;
+  int32 num_running_;
+  bool stopping_;
+  std::vector<std::thread> workers_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(TaskPool);
+};
+
+} // namespace kaldi
+
+#endif
@@ -0,0 +1,156 @@
+// util/work-stealing-scheduler.cc
+
+// Not in Kaldi.
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include "base/timer.h"
+#include "util/work-stealing-scheduler.h"
+
+namespace kaldi {
+
+namespace {
+
+// The tasks are coarse (whole utterances), so a mutex per deque is cheap
+// compared to the work, and keeps the stealing logic simple.
+class TaskDeque {
+ public:
+  void PushBack(size_t index) { tasks_.push_back(index); }
+
+  bool PopFront(size_t *index) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (tasks_.empty()) return false;
+    *index = tasks_.front();
+    tasks_.pop_front();
+    return true;
+  }
+
+  bool PopBack(size_t *index) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (tasks_.empty()) return false;
+    *index = tasks_.back();
+    tasks_.pop_back();
+    return true;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::deque<size_t> tasks_;
+};
+
+} // namespace
+
+std::vector<double> SchedulerStats::Utilization() const {
+  std::vector<double> ans(busy_time.size(), 0.0);
+  if (wall_time > 0.0) {
+    for (size_t i = 0; i < busy_time.size(); i++)
+      ans[i] = busy_time[i] / wall_time;
+  }
+  return ans;
+}
+
+std::string SchedulerStats::ToString() const {
+  std::ostringstream os;
+  std::vector<double> utilization = Utilization();
+  double total = 0.0;
+  os << std::fixed << std::setprecision(1);
+  for (size_t i = 0; i < utilization.size(); i++) {
+    os << "thread " << i << ": " << (100.0 * utilization[i]) << "% busy, "
+       << num_tasks[i] << " tasks, " << num_steals[i] << " stolen\n";
+    total += utilization[i];
+  }
+  if (!utilization.empty())
+    os << "average utilization " << (100.0 * total / utilization.size())
+       << "% over " << std::setprecision(3) << wall_time << " seconds";
+  return os.str();
+}
+
+WorkStealingScheduler::WorkStealingScheduler(int32 num_threads)
+    : num_threads_(num_threads) {
+  KALDI_ASSERT(num_threads > 0);
+}
+
+void WorkStealingScheduler::AddTask(int64 cost, Task task) {
+  PendingTask pending;
+  pending.cost = cost;
+  pending.task = std::move(task);
+  tasks_.push_back(std::move(pending));
+}
+
+void WorkStealingScheduler::Run(SchedulerStats *stats) {
+  std::vector<PendingTask> tasks;
+  tasks.swap(tasks_);
+  std::stable_sort(tasks.begin(), tasks.end(),
+                   [](const PendingTask &a, const PendingTask &b) {
+                     return a.cost > b.cost;
+                   });
+
+  const int32 num_threads = std::max<int32>(
+    1, std::min<int32>(num_threads_, tasks.size()));
+  std::vector<TaskDeque> deques(num_threads);
+  for (size_t i = 0; i < tasks.size(); i++)
+    deques[i % num_threads].PushBack(i);
+
+  std::vector<double> busy_time(num_threads, 0.0);
+  std::vector<int64> num_tasks(num_threads, 0), num_steals(num_threads, 0);
+  std::atomic<bool> failed(false);
+  std::exception_ptr error;
+  std::mutex error_mutex;
+
+  auto worker = [&](int32 t) {
+    size_t index;
+    while (!failed) {
+      bool stolen = false;
+      bool found = deques[t].PopFront(&index);
+      for (int32 k = 1; !found && k < num_threads; k++) {
+        found = deques[(t + k) % num_threads].PopBack(&index);
+        stolen = found;
+      }
+      // No task was added during Run(), so once every deque is seen empty
+      // there is nothing left to do.
+      if (!found) break;
+      Timer timer;
+      try {
+        tasks[index].task();
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (!failed) error = std::current_exception();
+        failed = true;
+      }
+      busy_time[t] += timer.Elapsed();
+      num_tasks[t]++;
+      num_steals[t] += stolen;
+    }
+  };
+
+  Timer timer;
+  if (num_threads == 1) {
+    worker(0);
+  } else {
+    std::vector<std::thread> threads;
+    for (int32 t = 0; t < num_threads; t++)
+      threads.emplace_back([&, t]() {
+        if (thread_init_) thread_init_(t);
+        worker(t);
+      });
+    for (auto &thread : threads)
+      thread.join();
+  }
+
+  if (stats != NULL) {
+    stats->wall_time = timer.Elapsed();
+    stats->busy_time = busy_time;
+    stats->num_tasks = num_tasks;
+    stats->num_steals = num_steals;
+  }
+  if (error)
+    std::rethrow_exception(error);
+}
+
+} // namespace kaldi
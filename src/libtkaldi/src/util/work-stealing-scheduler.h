@@ -0,0 +1,75 @@
+// util/work-stealing-scheduler.h
+
+// Not in Kaldi.
+//
+// A scheduler for batches of independent tasks of very different sizes, such
+// as feature extraction over utterances from 1 second to 30 minutes long.
+//
+// The tasks are sorted by decreasing cost and dealt round-robin to one deque
+// per worker thread, so that every worker starts with its longest task. A
+// worker takes tasks from the front of its own deque, and when it runs out,
+// steals from the back of the other workers' deques, i.e. the shortest
+// remaining tasks, which is what fills the gaps at the end of the batch.
+
+#ifndef KALDI_UTIL_WORK_STEALING_SCHEDULER_H_
+#define KALDI_UTIL_WORK_STEALING_SCHEDULER_H_
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "base/kaldi-common.h"
+
+namespace kaldi {
+
+/// Per-thread statistics of WorkStealingScheduler::Run().
+struct SchedulerStats {
+  double wall_time = 0.0;             // seconds
+  std::vector<double> busy_time;      // seconds spent in tasks, per thread
+  std::vector<int64> num_tasks;       // tasks run, per thread
+  std::vector<int64> num_steals;      // tasks stolen from others, per thread
+
+  /// The fraction of the wall time each thread spent in tasks.
+  std::vector<double> Utilization() const;
+
+  /// One line per thread, plus the average utilization.
+  std::string ToString() const;
+};
+
+class WorkStealingScheduler {
+ public:
+  typedef std::function<void()> Task;
+
+  /// With num_threads == 1, the tasks run on the calling thread.
+  explicit WorkStealingScheduler(int32 num_threads);
+
+  int32 NumThreads() const { return num_threads_; }
+
+  /// Adds a task. `cost` is an estimate of its run time in arbitrary units
+  /// (e.g. the number of samples), used to order the tasks.
+  void AddTask(int64 cost, Task task);
+
+  /// Optional hook run by each worker thread before it takes any task, with
+  /// the index of the thread (e.g. to configure thread-local state). It is
+  /// not run when the tasks run on the calling thread, whose state is left
+  /// alone. It must not throw.
+  void SetThreadInit(std::function<void(int32)> init) { thread_init_ = init; }
+
+  /// Runs all the tasks added so far, and returns when they are done. The
+  /// first exception thrown by a task is re-thrown here, after the remaining
+  /// tasks have been abandoned.
+  void Run(SchedulerStats *stats = NULL);
+
+ private:
+  struct PendingTask {
+    int64 cost;
+    Task task;
+  };
+
+  int32 num_threads_;
+  std::vector<PendingTask> tasks_;
+  std::function<void(int32)> thread_init_;
+};
+
+} // namespace kaldi
+
+#endif
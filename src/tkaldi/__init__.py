@@ -1,6 +1,8 @@
 """Initialize tkaldi submodules and TorchScript extension"""
 from . import (  # noqa: F401 # pylint: disable=unused-import
+    datasets,
     feats,
+    io,
 )
 
 
@@ -0,0 +1,50 @@
+"""Datasets over Kaldi data directories"""
+
+from typing import Iterator, Tuple
+
+import torch
+
+from . import feats
+
+
+def _read_scp(path: str):
+    with open(path) as file_:
+        for line in file_:
+            line = line.strip()
+            if line:
+                key, rxfilename = line.split(maxsplit=1)
+                yield key, rxfilename
+
+
+class KaldiPitchDataset(torch.utils.data.IterableDataset):
+    """Pitch features of the utterances of a ``wav.scp`` file
+
+    Yields ``(key, features)`` pairs, as ``compute-kaldi-pitch-feats``
+    writes them. With several ``DataLoader`` workers, each worker takes
+    every ``num_workers``-th line of the file, and computes the features in
+    shared memory, so handing them to the main process does not copy them.
+    Use ``batch_size=None`` (or a ``collate_fn`` which does not stack the
+    features) to keep it that way.
+
+    Args:
+        scp_path: The path of the ``wav.scp`` file.
+        channel: The channel to use, for multi-channel waves.
+        kwargs: Passed to :py:func:`tkaldi.feats.compute_kaldi_pitch`.
+    """
+    def __init__(self, scp_path: str, channel: int = 0, **kwargs):
+        super().__init__()
+        self.scp_path = scp_path
+        self.channel = channel
+        self.kwargs = kwargs
+
+    def __iter__(self) -> Iterator[Tuple[str, torch.Tensor]]:
+        worker = torch.utils.data.get_worker_info()
+        num_workers = 1 if worker is None else worker.num_workers
+        worker_id = 0 if worker is None else worker.id
+        for i, (key, rxfilename) in enumerate(_read_scp(self.scp_path)):
+            if i % num_workers != worker_id:
+                continue
+            wave, sample_frequency = feats.read_wave(rxfilename)
+            yield key, feats.compute_kaldi_pitch(
+                wave[self.channel], sample_frequency,
+                shared_memory=worker is not None, **self.kwargs)
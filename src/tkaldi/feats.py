@@ -1,7 +1,50 @@
 """Submodule for kaldi's featsbin"""
 
+import inspect
+from typing import List, Optional
+
 import torch
 
+# The default values of the option arguments of the pitch ops.
+_PITCH_DEFAULTS = (
+    25.0, 10.0, 0.0, 50, 400, 10.0, 0.1, 1000, 4000, 0.005, 7000,
+    1, 5, 0, 0, False, 500, False, True,
+)
+
+
+def read_wave(rxfilename: str):
+    """Read a wave file as Kaldi's tools do
+
+    Args:
+        rxfilename: A file name, or anything else Kaldi accepts as input, e.g.
+            a command ending with ``|`` as found in ``wav.scp``.
+
+    Returns:
+        The samples as a ``[channels, samples]`` tensor (not normalized, as
+        Kaldi reads them), and the sample frequency.
+    """
+    return torch.ops.tkaldi.ReadWave(rxfilename)
+
+
+def feature_cache(directory: str, max_bytes: int = 0):
+    """On-disk cache of features, for :py:func:`compute_kaldi_pitch`
+
+    Entries are keyed by a hash of the wave samples and of the options, and
+    a hit returns a tensor mapped from the cache file without copying it.
+    The cache can be shared by several processes.
+
+    Args:
+        directory: The directory where the entries are stored. It is created if
+            it does not exist.
+        max_bytes: If positive, the least recently used entries are removed
+            to keep the total size of the directory under this.
+
+    Returns:
+        A ``torch.classes.tkaldi.FeatureCache`` object. Its ``stats()`` method
+        returns the number of hits, misses, evictions and the bytes saved.
+    """
+    return torch.classes.tkaldi.FeatureCache(directory, max_bytes)
+
 
 def compute_kaldi_pitch(
         wave: torch.Tensor,
@@ -25,13 +68,249 @@ def compute_kaldi_pitch(
         recompute_frame: int = 500,
         nccf_ballast_online: bool = False,
         snip_edges: bool = True,
+        cache=None,
+        shared_memory: bool = False,
 ):
-    """Equivalent of `compute-kaldi-pitch-feats`"""
-    return torch.ops.tkaldi.ComputeKaldiPitch(
-        wave, sample_frequency, frame_length, frame_shift, preemph_coeff,
+    """Equivalent of `compute-kaldi-pitch-feats`
+
+    If ``cache`` (see :py:func:`feature_cache`) is given, the features of a
+    wave already processed with the same options are read from it, and the
+    features of the others are added to it.
+
+    If ``shared_memory``, the result is allocated in shared memory, so that
+    sending it to another process (e.g. from a ``DataLoader`` worker) passes
+    a file descriptor instead of copying it. With both options, features
+    read from ``cache`` are copied once from the cache file into shared
+    memory; the ones computed are not copied.
+
+    The extraction of one wave runs on one thread. To reduce the latency of a
+    long wave, :py:func:`compute_kaldi_pitch_batch` with ``max_chunk_length``
+    processes overlapping chunks of it in parallel, with an approximate
+    result.
+    """
+    options = (
+        frame_length, frame_shift, preemph_coeff,
         min_f0, max_f0, soft_min_f0, penalty_factor, lowpass_cutoff,
         resample_frequency, delta_pitch, nccf_ballast,
         lowpass_filter_width, upsample_filter_width, max_frames_latency,
         frames_per_chunk, simulate_first_pass_online, recompute_frame,
         nccf_ballast_online, snip_edges,
     )
+    if cache is not None:
+        return torch.ops.tkaldi.ComputeKaldiPitchCached(
+            wave, cache, sample_frequency, *options, shared_memory)
+    return torch.ops.tkaldi.ComputeKaldiPitch(
+        wave, sample_frequency, *options, shared_memory)
+
+
+def _pitch_options(kwargs):
+    """The option arguments of the pitch ops, from the keyword arguments of
+    :py:func:`compute_kaldi_pitch`"""
+    options = list(_PITCH_DEFAULTS)
+    params = list(inspect.signature(compute_kaldi_pitch).parameters)
+    names = params[2:2 + len(options)]
+    for key, value in kwargs.items():
+        if key not in names:
+            raise TypeError(f'Unexpected keyword argument: {key}')
+        options[names.index(key)] = value
+    return options
+
+
+def compute_kaldi_pitch_batch(
+        waves: List[torch.Tensor],
+        sample_frequency: float,
+        num_threads: int = 1,
+        max_chunk_length: float = 0.0,
+        chunk_overlap: float = 1.0,
+        intra_op_threads: int = 0,
+        cpu_affinity: str = 'none',
+        **kwargs,
+):
+    """Compute pitch of each of `waves` in parallel.
+
+    Keyword arguments other than the ones below are passed to
+    :py:func:`compute_kaldi_pitch`, and the results are the same as calling it
+    on each wave.
+
+    Args:
+        num_threads: The number of worker threads. Long and short waves are
+            balanced across the threads by work stealing.
+        max_chunk_length: If positive, waves longer than this (in seconds) are
+            split into overlapping chunks which are processed in parallel.
+            The pitch is tracked separately in each chunk, so the result is an
+            approximation.
+        chunk_overlap: The overlap between chunks in seconds.
+        intra_op_threads: The number of intra-op threads of each worker
+            thread, or 0 to leave it unchanged. Only applies when
+            ``num_threads > 1``. This calls ``torch.set_num_threads``,
+            which changes the setting of the whole process while the batch
+            runs (with ATen's native thread pool), including for other
+            threads running torch ops; the previous value is restored
+            when the batch is done.
+        cpu_affinity: ``'none'``, ``'node'`` to bind each worker thread to
+            the CPUs and memory of a NUMA node (round-robin), or ``'cpu'``
+            to bind each to a single CPU.
+    """
+    return torch.ops.tkaldi.ComputeKaldiPitchBatch(
+        waves, sample_frequency, *_pitch_options(kwargs),
+        num_threads, max_chunk_length, chunk_overlap,
+        intra_op_threads, cpu_affinity)
+
+
+def async_pool(num_threads: int = 1, max_pending: int = 4):
+    """Worker threads for :py:func:`compute_kaldi_pitch_async` and
+    :py:func:`resample_waveform_async`
+
+    Args:
+        num_threads: The number of worker threads.
+        max_pending: The number of calls which can wait for a worker. When
+            it is reached, the async functions block until a worker is free,
+            or raise with ``block=False``.
+
+    Returns:
+        A ``torch.classes.tkaldi.AsyncPool`` object. Its ``num_pending()``
+        method returns the number of calls queued or running.
+    """
+    return torch.classes.tkaldi.AsyncPool(num_threads, max_pending)
+
+
+def compute_kaldi_pitch_async(
+        wave: torch.Tensor,
+        sample_frequency: float,
+        pool,
+        block: bool = True,
+        **kwargs,
+):
+    """Start :py:func:`compute_kaldi_pitch` on the workers of ``pool``
+
+    Other keyword arguments are passed to :py:func:`compute_kaldi_pitch`.
+    ``wave`` must not be modified until the result is ready.
+
+    Args:
+        block: If the pool is full, wait for a free slot (holding the GIL,
+            so other Python threads do not run meanwhile) if ``True``, or
+            raise ``RuntimeError`` if ``False``.
+
+    Returns:
+        A ``torch.futures.Future`` of the features, which can also be waited
+        for with ``torch.jit.wait`` in TorchScript. Its ``wait()`` method
+        raises the error of the computation, if any.
+    """
+    return torch.ops.tkaldi.ComputeKaldiPitchAsync(
+        wave, pool, block, sample_frequency, *_pitch_options(kwargs))
+
+
+def resample_waveform_async(
+        wave: torch.Tensor,
+        orig_freq: float,
+        new_freq: float,
+        pool,
+        block: bool = True,
+):
+    """Start the resampling of ``wave`` on the workers of ``pool``
+
+    See :py:func:`compute_kaldi_pitch_async` for ``block`` and the result.
+    """
+    return torch.ops.tkaldi.ResampleWaveformAsync(
+        wave, pool, block, orig_freq, new_freq)
+
+
+def process_pitch(
+        feats: torch.Tensor,
+        pitch_scale: float = 2.0,
+        pov_scale: float = 2.0,
+        pov_offset: float = 0.0,
+        delta_pitch_scale: float = 10.0,
+        delta_pitch_noise_stddev: float = 0.005,
+        normalization_left_context: int = 75,
+        normalization_right_context: int = 75,
+        delta_window: int = 2,
+        delay: int = 0,
+        add_pov_feature: bool = True,
+        add_normalized_log_pitch: bool = True,
+        add_delta_pitch: bool = True,
+        add_raw_log_pitch: bool = False,
+        method: str = 'reference',
+):
+    """Equivalent of `process-kaldi-pitch-feats`
+
+    Args:
+        feats: The output of :py:func:`compute_kaldi_pitch`.
+        method: ``'reference'`` runs Kaldi's ``ProcessPitch``.
+            ``'approximate'`` computes the whole utterance with tensor
+            operations; it matches ``'reference'`` only up to rounding
+            (about 1e-5).
+    """
+    return torch.ops.tkaldi.ProcessPitch(
+        feats, pitch_scale, pov_scale, pov_offset, delta_pitch_scale,
+        delta_pitch_noise_stddev, normalization_left_context,
+        normalization_right_context, delta_window, delay, add_pov_feature,
+        add_normalized_log_pitch, add_delta_pitch, add_raw_log_pitch, method)
+
+
+def compute_cmvn_stats(
+        feats: List[torch.Tensor],
+        groups: Optional[List[int]] = None,
+        weights: Optional[List[torch.Tensor]] = None,
+        num_threads: int = 1,
+):
+    """Equivalent of `compute-cmvn-stats`
+
+    Args:
+        feats: Feature matrices of the same dimension. They can be stored
+            as ``float32``, ``float16`` or ``bfloat16`` (all the same); the
+            values are converted to ``float32`` as they are read, without
+            converting the matrices first.
+        groups: The group (e.g. speaker) index of each of ``feats``. By
+            default, all the matrices are in one group (global stats).
+        weights: Optional per-frame weights of each of ``feats``.
+        num_threads: The groups are accumulated in parallel with this many
+            threads.
+
+    Returns:
+        The stats of each group, as a float64 tensor of shape
+        ``[num_groups, 2, dim + 1]``, in Kaldi's layout.
+    """
+    if groups is None:
+        groups = [0] * len(feats)
+    num_groups = max(groups) + 1 if groups else 0
+    return torch.ops.tkaldi.ComputeCmvnStats(
+        feats, weights or [], groups, num_groups, num_threads)
+
+
+def apply_cmvn(
+        feats: List[torch.Tensor],
+        stats: torch.Tensor,
+        groups: Optional[List[int]] = None,
+        norm_means: bool = True,
+        norm_vars: bool = False,
+        reverse: bool = False,
+        num_threads: int = 1,
+):
+    """Equivalent of `apply-cmvn`, normalizing ``feats`` in place
+
+    Args:
+        feats: float32 feature matrices, modified in place.
+        stats: The output of :py:func:`compute_cmvn_stats`, or the stats of
+            a single group (shape ``[2, dim + 1]``).
+        groups: The index in ``stats`` of the stats of each of ``feats``. By
+            default, the first stats are used for all.
+        num_threads: The matrices are normalized in parallel with this many
+            threads.
+
+    Returns:
+        ``feats``.
+    """
+    if norm_vars and not norm_means:
+        raise ValueError(
+            'You cannot normalize the variance but not the mean.')
+    if not norm_means:
+        return feats
+    if stats.dim() == 2:
+        stats = stats.unsqueeze(0)
+    if groups is None:
+        groups = [0] * len(feats)
+    torch.ops.tkaldi.ApplyCmvn_(
+        feats, stats.to(torch.float64), groups, norm_vars, reverse,
+        num_threads)
+    return feats
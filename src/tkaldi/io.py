@@ -0,0 +1,59 @@
+"""Submodule for reading and writing features as NumPy files
+
+Matrices are read by mapping the file into memory (copy-on-write), so
+reading does not copy them. The files written can be loaded with
+``numpy.load``.
+"""
+
+import torch
+
+
+def read_npy(path: str) -> torch.Tensor:
+    """Read the matrix of a ``.npy`` file
+
+    Args:
+        path: The path of a ``.npy`` file holding a 2-D ``float32`` or
+            ``float64`` array in C order. ``float64`` arrays are converted.
+
+    Returns:
+        A ``float32`` tensor.
+    """
+    return torch.ops.tkaldi.ReadNpy(path)
+
+
+def write_npy(path: str, matrix: torch.Tensor):
+    """Write a ``float32`` matrix to a ``.npy`` file"""
+    torch.ops.tkaldi.WriteNpy(path, matrix)
+
+
+def npy_archive(rspecifier: str):
+    """The matrices of a ``.npz`` archive or of a corpus ``.npy``, by key
+
+    Args:
+        rspecifier: ``'npz:<path>'``, for an archive as written by
+            ``numpy.savez`` (not ``savez_compressed``) with one array per
+            key, or ``'npy:<path>'``, for a single ``.npy`` of the rows of
+            all the matrices, with the index ``<path>.index`` of lines
+            ``<key> <first-row> <num-rows>``.
+
+    Returns:
+        A ``torch.classes.tkaldi.NpyArchive`` object. Its ``keys()``,
+        ``contains(key)``, ``get(key)`` and ``size()`` methods take constant
+        time per key.
+    """
+    return torch.classes.tkaldi.NpyArchive(rspecifier)
+
+
+def npy_archive_writer(wspecifier: str):
+    """Write matrices to a ``.npz`` archive or a corpus ``.npy``
+
+    Args:
+        wspecifier: ``'npz:<path>'`` or ``'npy:<path>'``, as for
+            :py:func:`npy_archive`. The matrices of a corpus ``.npy`` must
+            have the same number of columns.
+
+    Returns:
+        A ``torch.classes.tkaldi.NpyArchiveWriter`` object. Call its
+        ``write(key, matrix)`` method for each matrix, then ``close()``.
+    """
+    return torch.classes.tkaldi.NpyArchiveWriter(wspecifier)
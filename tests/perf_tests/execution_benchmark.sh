@@ -0,0 +1,48 @@
+#!/usr/bin/env bash
+
+# Throughput of compute-kaldi-pitch-feats-parallel with different worker
+# placements, e.g. on a machine with several NUMA nodes (no results are
+# recorded in the tree):
+#
+#   ./tests/perf_tests/execution_benchmark.sh 5 400 32
+
+set -eu
+
+audio_length="$1"
+num_repeats="$2"
+num_threads="$3"
+
+rate=16000
+
+WORKDIR="$(mktemp -d)"
+cleanup () { rm -rf "${WORKDIR}"; }
+trap cleanup EXIT
+
+audio_path="${WORKDIR}/foo.wav"
+scp_path="${WORKDIR}/foo.scp"
+ark_path="${WORKDIR}/foo.ark"
+
+: > "${scp_path}"
+for i in $(seq ${num_repeats}); do
+    printf "%s %s\n" "$i" "${audio_path}" >> "${scp_path}"
+done
+sox --bits 16 --rate "${rate}" --null --channels 1 "${audio_path}" synth "${audio_length}" sine 300 vol -10db
+
+which compute-kaldi-pitch-feats-parallel
+lscpu | grep -i numa || true
+
+printf "%-8s %-16s %10s %14s\n" affinity intra-op-threads seconds utts/second
+for affinity in none node cpu; do
+    for intra_op_threads in 0 1; do
+        start=$(date +%s.%N)
+        compute-kaldi-pitch-feats-parallel --sample-frequency="${rate}" \
+            --num-threads="${num_threads}" \
+            --intra-op-threads="${intra_op_threads}" \
+            --cpu-affinity="${affinity}" \
+            "scp:${scp_path}" "ark:${ark_path}" 2> /dev/null
+        end=$(date +%s.%N)
+        printf "%-8s %-16s %10.2f %14.1f\n" "${affinity}" "${intra_op_threads}" \
+            "$(echo "${end} - ${start}" | bc)" \
+            "$(echo "${num_repeats} / (${end} - ${start})" | bc -l)"
+    done
+done
@@ -0,0 +1,58 @@
+#!/usr/bin/env bash
+
+# Run time of compute-kaldi-pitch-feats in the online-simulating
+# configurations, compared with the plain one, e.g.
+#
+#   ./tests/perf_tests/online_benchmark.sh 30 20
+#
+# In the chunked configurations, the NCCF of the first recompute_frame
+# frames is computed with a provisional ballast; once the signal statistics
+# are known, the extractor rescales the cached NCCF of those frames with the
+# final ballast and re-runs the Viterbi pass over them. With
+# --nccf-ballast-online there is no such recomputation, so the difference
+# between the "chunked" and "ballast-online" rows bounds its cost.
+
+set -eu
+
+audio_length="$1"
+num_repeats="$2"
+
+rate=16000
+
+WORKDIR="$(mktemp -d)"
+cleanup () { rm -rf "${WORKDIR}"; }
+trap cleanup EXIT
+
+audio_path="${WORKDIR}/foo.wav"
+scp_path="${WORKDIR}/foo.scp"
+ark_path="${WORKDIR}/foo.ark"
+
+: > "${scp_path}"
+for i in $(seq ${num_repeats}); do
+    printf "%s %s\n" "$i" "${audio_path}" >> "${scp_path}"
+done
+sox --bits 16 --rate "${rate}" --null --channels 1 "${audio_path}" synth "${audio_length}" sine 300 vol -10db
+
+which compute-kaldi-pitch-feats
+
+configs=(
+    "plain|"
+    "chunked|--frames-per-chunk=10"
+    "chunked,recompute-frame=100|--frames-per-chunk=10 --recompute-frame=100"
+    "ballast-online|--frames-per-chunk=10 --nccf-ballast-online=true"
+    "first-pass|--frames-per-chunk=10 --simulate-first-pass-online=true"
+)
+
+printf "%-32s %10s %14s\n" config seconds utts/second
+for config in "${configs[@]}"; do
+    name="${config%%|*}"
+    options="${config#*|}"
+    start=$(date +%s.%N)
+    # shellcheck disable=SC2086
+    compute-kaldi-pitch-feats --sample-frequency="${rate}" ${options} \
+        "scp:${scp_path}" "ark:${ark_path}" 2> /dev/null
+    end=$(date +%s.%N)
+    printf "%-32s %10.2f %14.1f\n" "${name}" \
+        "$(echo "${end} - ${start}" | bc)" \
+        "$(echo "${num_repeats} / (${end} - ${start})" | bc -l)"
+done
@@ -0,0 +1,131 @@
+// Compares the kernels which take reduced precision input (float16 and
+// bfloat16 storage, see matrix/reduced-precision.h) with the float path: the
+// time per call, and the error of the result against the float path on the
+// same data before it was rounded to the storage type. No results are
+// recorded in the tree.
+//
+// Usage: precision-benchmark [num-iterations]
+
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "base/kaldi-common.h"
+#include "base/timer.h"
+#include "feat/resample-banded.h"
+#include "transform/cmvn.h"
+
+using namespace kaldi;
+
+namespace {
+
+// The largest absolute difference, and the largest difference relative to
+// the largest absolute value of `reference`.
+void Compare(const torch::Tensor &reference, const torch::Tensor &found,
+             double *max_abs, double *max_rel) {
+  auto diff = (reference.to(torch::kFloat64) - found.to(torch::kFloat64)).abs();
+  *max_abs = diff.max().item<double>();
+  *max_rel = *max_abs / reference.to(torch::kFloat64).abs().max().item<double>();
+}
+
+void Print(const std::string &name, const std::string &storage, double us,
+           double max_abs, double max_rel) {
+  std::cout << std::left << std::setw(16) << name << std::setw(10) << storage
+            << std::right << std::setw(12) << std::fixed << std::setprecision(1)
+            << us << std::setw(14) << std::scientific << std::setprecision(2)
+            << max_abs << std::setw(14) << max_rel << "\n";
+}
+
+template<typename Compute>
+double Time(int32 num_iters, Compute compute) {
+  compute();  // warm up
+  Timer timer;
+  for (int32 i = 0; i < num_iters; i++) compute();
+  return timer.Elapsed() * 1.0e6 / num_iters;
+}
+
+// NCCF upsampling of 60 seconds of frames, with the default pitch options.
+void RunResample(int32 num_iters) {
+  const BaseFloat resample_freq = 4000.0, min_f0 = 50.0, max_f0 = 400.0,
+    delta_pitch = 0.005;
+  std::vector<BaseFloat> lags(1, 1.0 / max_f0);
+  while (lags.back() * (1.0 + delta_pitch) <= 1.0 / min_f0)
+    lags.push_back(lags.back() * (1.0 + delta_pitch));
+  const int32 first_lag = static_cast<int32>(resample_freq / max_f0) - 5,
+    last_lag = static_cast<int32>(resample_freq / min_f0) + 5;
+  Vector<BaseFloat> sample_points(lags.size());
+  for (size_t i = 0; i < lags.size(); i++)
+    sample_points(i) = lags[i] - first_lag / resample_freq;
+  BandedResample banded(last_lag + 1 - first_lag, resample_freq,
+                        resample_freq / 2, sample_points, 5);
+
+  const int32 num_frames = 6000;
+  torch::Tensor nccf = torch::rand({num_frames, banded.NumSamplesIn()}) * 2 - 1;
+  Matrix<BaseFloat> reference(num_frames, banded.NumSamplesOut()),
+    output(num_frames, banded.NumSamplesOut());
+  StorageMatrix<BaseFloat> input(nccf);
+  double us = Time(num_iters, [&]() {
+    banded.ResampleFused(input, &reference);
+  });
+  Print("NCCF resample", "float", us, 0.0, 0.0);
+
+  torch::Tensor half = nccf.to(torch::kFloat16),
+    bfloat = nccf.to(torch::kBFloat16);
+  StorageMatrix<c10::Half> half_view(half);
+  StorageMatrix<c10::BFloat16> bfloat_view(bfloat);
+  double max_abs, max_rel;
+  us = Time(num_iters, [&]() { banded.ResampleFused(half_view, &output); });
+  Compare(reference.tensor_, output.tensor_, &max_abs, &max_rel);
+  Print("NCCF resample", "float16", us, max_abs, max_rel);
+  us = Time(num_iters, [&]() { banded.ResampleFused(bfloat_view, &output); });
+  Compare(reference.tensor_, output.tensor_, &max_abs, &max_rel);
+  Print("NCCF resample", "bfloat16", us, max_abs, max_rel);
+}
+
+// CMVN stats of 10 minutes of 40-dimensional features.
+void RunCmvnStats(int32 num_iters) {
+  const int32 num_frames = 60000, dim = 40;
+  torch::Tensor feats = torch::randn({num_frames, dim}) * 5 + 2;
+  Matrix<double> reference, stats;
+  InitCmvnStats(dim, &reference);
+  InitCmvnStats(dim, &stats);
+  MatrixBase<BaseFloat> input(feats);
+  double us = Time(num_iters, [&]() {
+    reference.SetZero();
+    AccCmvnStats(input, NULL, &reference);
+  });
+  Print("CMVN stats", "float", us, 0.0, 0.0);
+
+  torch::Tensor half = feats.to(torch::kFloat16),
+    bfloat = feats.to(torch::kBFloat16);
+  StorageMatrix<c10::Half> half_view(half);
+  StorageMatrix<c10::BFloat16> bfloat_view(bfloat);
+  double max_abs, max_rel;
+  us = Time(num_iters, [&]() {
+    stats.SetZero();
+    AccCmvnStats(half_view, NULL, &stats);
+  });
+  Compare(reference.tensor_, stats.tensor_, &max_abs, &max_rel);
+  Print("CMVN stats", "float16", us, max_abs, max_rel);
+  us = Time(num_iters, [&]() {
+    stats.SetZero();
+    AccCmvnStats(bfloat_view, NULL, &stats);
+  });
+  Compare(reference.tensor_, stats.tensor_, &max_abs, &max_rel);
+  Print("CMVN stats", "bfloat16", us, max_abs, max_rel);
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  const int32 num_iters = argc > 1 ? std::atoi(argv[1]) : 20;
+  std::cout << std::left << std::setw(16) << "kernel" << std::setw(10)
+            << "storage" << std::right << std::setw(12) << "time[us]"
+            << std::setw(14) << "max abs err" << std::setw(14)
+            << "max rel err" << "\n";
+  RunResample(num_iters);
+  RunCmvnStats(num_iters);
+  return 0;
+}
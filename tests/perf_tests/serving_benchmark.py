@@ -0,0 +1,97 @@
+"""Throughput of a serving loop which extracts pitch and runs a model on
+each request, with and without overlapping the extraction of request N+1
+with the forward pass of request N.
+
+    python tests/perf_tests/serving_benchmark.py --num-requests 200
+"""
+import argparse
+import math
+import time
+
+import torch
+import tkaldi
+
+
+def _parse_args():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('--num-requests', type=int, default=100)
+    parser.add_argument('--audio-length', type=float, default=5.0)
+    parser.add_argument('--sample-rate', type=int, default=16000)
+    parser.add_argument('--hidden-size', type=int, default=512)
+    parser.add_argument('--num-layers', type=int, default=3)
+    parser.add_argument('--num-workers', type=int, default=1)
+    parser.add_argument('--max-pending', type=int, default=2)
+    return parser.parse_args()
+
+
+class _Model(torch.nn.Module):
+    def __init__(self, hidden_size, num_layers):
+        super().__init__()
+        self.lstm = torch.nn.LSTM(2, hidden_size, num_layers)
+        self.linear = torch.nn.Linear(hidden_size, 100)
+
+    def forward(self, feats):
+        out, _ = self.lstm(feats.unsqueeze(1))
+        return self.linear(out).squeeze(1)
+
+
+def _get_requests(num_requests, audio_length, sample_rate):
+    num_samples = int(audio_length * sample_rate)
+    time_ = torch.arange(num_samples, dtype=torch.float) / sample_rate
+    return [
+        1000 * torch.sin(2 * math.pi * (100 + i % 200) * time_)
+        for i in range(num_requests)
+    ]
+
+
+def _serve_serial(model, requests, sample_rate):
+    outputs = []
+    for wave in requests:
+        feats = tkaldi.feats.compute_kaldi_pitch(wave, sample_rate)
+        outputs.append(model(feats))
+    return outputs
+
+
+def _serve_overlap(model, requests, sample_rate, pool):
+    outputs = []
+    pending = tkaldi.feats.compute_kaldi_pitch_async(
+        requests[0], sample_rate, pool)
+    for i in range(len(requests)):
+        feats = pending.wait()
+        if i + 1 < len(requests):
+            pending = tkaldi.feats.compute_kaldi_pitch_async(
+                requests[i + 1], sample_rate, pool)
+        outputs.append(model(feats))
+    return outputs
+
+
+def _main():
+    args = _parse_args()
+    torch.manual_seed(0)
+    model = torch.jit.script(_Model(args.hidden_size, args.num_layers).eval())
+    requests = _get_requests(
+        args.num_requests, args.audio_length, args.sample_rate)
+    pool = tkaldi.feats.async_pool(args.num_workers, args.max_pending)
+
+    print(f'{"mode":<10} {"seconds":>10} {"requests/second":>16}')
+    results = {}
+    with torch.no_grad():
+        for mode in ['serial', 'overlap']:
+            start = time.monotonic()
+            if mode == 'serial':
+                outputs = _serve_serial(model, requests, args.sample_rate)
+            else:
+                outputs = _serve_overlap(
+                    model, requests, args.sample_rate, pool)
+            elapsed = time.monotonic() - start
+            results[mode] = outputs
+            print(f'{mode:<10} {elapsed:10.2f} '
+                  f'{len(requests) / elapsed:16.1f}')
+    identical = all(
+        torch.equal(a, b)
+        for a, b in zip(results['serial'], results['overlap']))
+    print(f'identical outputs: {identical}')
+
+
+if __name__ == '__main__':
+    _main()
@@ -0,0 +1,64 @@
+#!/usr/bin/env bash
+
+# Per-invocation run time and peak memory of compute-kaldi-pitch-feats on a
+# tiny shard, for builds with either storage backend of the Vector / Matrix
+# shim, e.g.
+#
+#   BUILD_LEAN_CLI=0 python setup.py build_ext --build-temp build/tensor
+#   cp -r src/tkaldi/bin bin-tensor
+#   BUILD_LEAN_CLI=1 python setup.py build_ext --build-temp build/lean
+#   cp -r src/tkaldi/bin bin-lean
+#   ./tests/perf_tests/startup_benchmark.sh 200 0.5 bin-tensor bin-lean
+#
+# With one short utterance per invocation, the time is dominated by process
+# startup: loading the shared libraries and, with the tensor backend,
+# initializing libtorch (static initializers, operator registration).
+# Requires GNU time (/usr/bin/time) for the peak RSS.
+
+set -eu
+
+num_invocations="$1"
+audio_length="$2"
+shift 2
+
+rate=16000
+
+WORKDIR="$(mktemp -d)"
+cleanup () { rm -rf "${WORKDIR}"; }
+trap cleanup EXIT
+
+audio_path="${WORKDIR}/foo.wav"
+scp_path="${WORKDIR}/foo.scp"
+ark_path="${WORKDIR}/foo.ark"
+
+printf "%s %s\n" "utt" "${audio_path}" > "${scp_path}"
+sox --bits 16 --rate "${rate}" --null --channels 1 "${audio_path}" synth "${audio_length}" sine 300 vol -10db
+
+printf "%-24s %10s %14s %10s\n" bin_dir ms/run max-rss/MB libtorch
+for bin_dir in "$@"; do
+    binary="${bin_dir}/compute-kaldi-pitch-feats"
+    if ldd "${binary}" | grep -q libtorch; then
+        libtorch=yes
+    else
+        libtorch=no
+    fi
+    # Warm the page cache.
+    "${binary}" --sample-frequency="${rate}" "scp:${scp_path}" "ark:${ark_path}" 2> /dev/null
+
+    max_rss=0
+    start=$(date +%s.%N)
+    for _ in $(seq "${num_invocations}"); do
+        /usr/bin/time -f "%M" -o "${WORKDIR}/rss" \
+            "${binary}" --sample-frequency="${rate}" \
+            "scp:${scp_path}" "ark:${ark_path}" 2> /dev/null
+        rss=$(cat "${WORKDIR}/rss")
+        if [ "${rss}" -gt "${max_rss}" ]; then
+            max_rss="${rss}"
+        fi
+    done
+    end=$(date +%s.%N)
+    printf "%-24s %10.1f %14.1f %10s\n" "${bin_dir}" \
+        "$(echo "1000 * (${end} - ${start}) / ${num_invocations}" | bc -l)" \
+        "$(echo "${max_rss} / 1024" | bc -l)" \
+        "${libtorch}"
+done
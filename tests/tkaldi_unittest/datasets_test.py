@@ -0,0 +1,35 @@
+"""Test """
+
+import torch
+import tkaldi
+
+from tkaldi_unittest import utils
+
+
+class KaldiPitchDatasetTest(utils.case.TestCase):
+    def test_kaldi_pitch_dataset(self):
+        """KaldiPitchDataset yields the features of every utterance once"""
+        sample_rate = 16000
+        scp_path = self.get_temp_path('wav.scp')
+        expected = {}
+        with open(scp_path, 'w') as file_:
+            for i, frequency in enumerate([300, 200, 150, 100, 250]):
+                wave = utils.data.get_sinusoid(
+                    sample_rate=sample_rate, frequency=frequency,
+                    num_channels=1, dtype='int16')[0]
+                path = self.get_temp_path(f'{i}.wav')
+                utils.io.save_wav(path, wave, sample_rate)
+                file_.write(f'utt{i} {path}\n')
+                expected[f'utt{i}'] = tkaldi.feats.compute_kaldi_pitch(
+                    wave.to(torch.float), sample_rate)
+
+        dataset = tkaldi.datasets.KaldiPitchDataset(scp_path)
+        loader = torch.utils.data.DataLoader(
+            dataset, batch_size=None, num_workers=2)
+        found = {}
+        for key, feats in loader:
+            self.assertTrue(feats.is_shared())
+            found[key] = feats
+        self.assertEqual(sorted(expected), sorted(found))
+        for key, feats in expected.items():
+            self.assertEqual(feats, found[key])
@@ -1,11 +1,19 @@
 """Test """
 
+import os
+import subprocess
+import unittest
+from pathlib import Path
+
+import kaldi_io
 import torch
 import tkaldi
 from parameterized import parameterized
 
 from tkaldi_unittest import utils
 
+_TKALDI_PITCH_BIN = Path(tkaldi.__file__).parent / 'bin' / 'compute-kaldi-pitch-feats'
+
 
 class PitchTest(utils.case.TestCase):
     @parameterized.expand([
@@ -34,3 +42,334 @@ class PitchTest(utils.case.TestCase):
         expected = utils.kaldi.run_command_scp(command, path)
 
         self.assertEqual(expected, found)
+
+    @unittest.skipIf(not _TKALDI_PITCH_BIN.exists(),
+                     'compute-kaldi-pitch-feats of tkaldi is not built')
+    def test_compute_kaldi_pitch_feats_cli(self):
+        """compute-kaldi-pitch-feats of tkaldi matches the op and Kaldi
+
+        The executables are built with either storage backend of the shim
+        (BUILD_LEAN_CLI=1 for the lean one, which is then also checked not to
+        link libtorch), so the results may differ from those of the op by
+        rounding: the tolerance is 1e-4 relative and 1e-3 absolute.
+        """
+        sample_rate = 16000
+        original = utils.data.get_sinusoid(
+            sample_rate=sample_rate, frequency=300,
+            num_channels=1, dtype='int16')[0]
+        path = self.get_temp_path('test.wav')
+        utils.io.save_wav(path, original, sample_rate)
+
+        _args = utils.kaldi.convert_args(sample_frequency=sample_rate)
+        found = utils.kaldi.run_command_scp(
+            [str(_TKALDI_PITCH_BIN)] + _args + ['scp:-', 'ark:-'], path)
+        op = tkaldi.feats.compute_kaldi_pitch(
+            original.to(dtype=torch.float), sample_rate)
+        kaldi = utils.kaldi.run_command_scp(
+            ['compute-kaldi-pitch-feats'] + _args + ['scp:-', 'ark:-'], path)
+        self.assertEqual(op, found, rtol=1e-4, atol=1e-3)
+        self.assertEqual(kaldi, found, rtol=1e-4, atol=1e-3)
+
+        if os.environ.get('BUILD_LEAN_CLI', '0') == '1':
+            libs = subprocess.check_output(['ldd', str(_TKALDI_PITCH_BIN)])
+            self.assertNotIn(b'libtorch', libs)
+
+    @parameterized.expand([
+        (16000, {}),
+        (16000, {'min_f0': 60}),
+    ])
+    def test_compute_kaldi_pitch_shared_memory(self, sample_rate, args):
+        """compute_kaldi_pitch returns the same result in shared memory"""
+        wave = utils.data.get_sinusoid(
+            sample_rate=sample_rate, frequency=300,
+            num_channels=1, dtype='int16')[0].to(dtype=torch.float)
+        expected = tkaldi.feats.compute_kaldi_pitch(wave, sample_rate, **args)
+        found = tkaldi.feats.compute_kaldi_pitch(
+            wave, sample_rate, shared_memory=True, **args)
+        self.assertTrue(found.is_shared())
+        self.assertEqual(expected, found)
+
+    def test_read_wave(self):
+        """read_wave reads the samples as they are stored"""
+        sample_rate = 8000
+        original = utils.data.get_sinusoid(
+            sample_rate=sample_rate, frequency=300,
+            num_channels=1, dtype='int16')[0]
+        path = self.get_temp_path('test.wav')
+        utils.io.save_wav(path, original, sample_rate)
+        wave, found_rate = tkaldi.feats.read_wave(path)
+        self.assertEqual(found_rate, sample_rate)
+        self.assertEqual(original.to(torch.float).unsqueeze(0), wave)
+
+    def test_compute_kaldi_pitch_batch(self):
+        """compute_kaldi_pitch_batch matches compute_kaldi_pitch on each wave"""
+        sample_rate = 16000
+        waves = [
+            utils.data.get_sinusoid(
+                sample_rate=sample_rate, frequency=frequency, duration=duration,
+                num_channels=1, dtype='int16')[0].to(dtype=torch.float)
+            for frequency, duration in [(300, 3), (200, 1), (150, 0.5), (250, 2)]
+        ]
+        found = tkaldi.feats.compute_kaldi_pitch_batch(
+            waves, sample_rate, num_threads=3)
+        for wave, result in zip(waves, found):
+            expected = tkaldi.feats.compute_kaldi_pitch(wave, sample_rate)
+            self.assertEqual(expected, result)
+
+    @parameterized.expand([('none', ), ('node', ), ('cpu', )])
+    def test_compute_kaldi_pitch_batch_affinity(self, cpu_affinity):
+        """compute_kaldi_pitch_batch does not depend on the thread placement"""
+        sample_rate = 16000
+        waves = [
+            utils.data.get_sinusoid(
+                sample_rate=sample_rate, frequency=frequency,
+                num_channels=1, dtype='int16')[0].to(dtype=torch.float)
+            for frequency in [300, 200, 150]
+        ]
+        found = tkaldi.feats.compute_kaldi_pitch_batch(
+            waves, sample_rate, num_threads=2, intra_op_threads=1,
+            cpu_affinity=cpu_affinity)
+        for wave, result in zip(waves, found):
+            expected = tkaldi.feats.compute_kaldi_pitch(wave, sample_rate)
+            self.assertEqual(expected, result)
+
+    def test_compute_kaldi_pitch_batch_restores_num_threads(self):
+        """compute_kaldi_pitch_batch restores the number of intra-op threads"""
+        sample_rate = 16000
+        wave = utils.data.get_sinusoid(
+            sample_rate=sample_rate, frequency=300,
+            num_channels=1, dtype='int16')[0].to(dtype=torch.float)
+        num_threads = torch.get_num_threads()
+        tkaldi.feats.compute_kaldi_pitch_batch(
+            [wave, wave], sample_rate, num_threads=2,
+            intra_op_threads=num_threads + 1)
+        self.assertEqual(torch.get_num_threads(), num_threads)
+
+    def test_compute_kaldi_pitch_cache(self):
+        """compute_kaldi_pitch returns the same result through the cache"""
+        sample_rate = 16000
+        wave = utils.data.get_sinusoid(
+            sample_rate=sample_rate, frequency=300,
+            num_channels=1, dtype='int16')[0].to(dtype=torch.float)
+        cache = tkaldi.feats.feature_cache(self.get_temp_path('cache'))
+
+        compute = tkaldi.feats.compute_kaldi_pitch
+        expected = compute(wave, sample_rate)
+        first = compute(wave, sample_rate, cache=cache)
+        second = compute(wave, sample_rate, cache=cache)
+        other = compute(wave, sample_rate, min_f0=60, cache=cache)
+        self.assertEqual(expected, first)
+        self.assertEqual(expected, second)
+        self.assertEqual(compute(wave, sample_rate, min_f0=60), other)
+        stats = cache.stats()
+        self.assertEqual(stats['num_hits'], 1)
+        self.assertEqual(stats['num_misses'], 2)
+        self.assertEqual(stats['bytes_saved'], second.numel() * 4)
+
+    def test_compute_kaldi_pitch_cache_shared_memory(self):
+        """compute_kaldi_pitch returns cached features in shared memory"""
+        sample_rate = 16000
+        wave = utils.data.get_sinusoid(
+            sample_rate=sample_rate, frequency=300,
+            num_channels=1, dtype='int16')[0].to(dtype=torch.float)
+        cache = tkaldi.feats.feature_cache(self.get_temp_path('cache'))
+
+        compute = tkaldi.feats.compute_kaldi_pitch
+        expected = compute(wave, sample_rate)
+        first = compute(wave, sample_rate, cache=cache, shared_memory=True)
+        second = compute(wave, sample_rate, cache=cache, shared_memory=True)
+        self.assertTrue(first.is_shared())
+        self.assertTrue(second.is_shared())
+        self.assertEqual(expected, first)
+        self.assertEqual(expected, second)
+        stats = cache.stats()
+        self.assertEqual(stats['num_hits'], 1)
+        self.assertEqual(stats['num_misses'], 1)
+
+
+class AsyncTest(utils.case.TestCase):
+    def test_compute_kaldi_pitch_async(self):
+        """compute_kaldi_pitch_async returns the same result as the sync op"""
+        sample_rate = 16000
+        waves = [
+            utils.data.get_sinusoid(
+                sample_rate=sample_rate, frequency=frequency,
+                num_channels=1, dtype='int16')[0].to(dtype=torch.float)
+            for frequency in [300, 200, 150, 100]
+        ]
+        # Fewer pending slots than calls, so that some calls wait for a slot.
+        pool = tkaldi.feats.async_pool(num_threads=2, max_pending=1)
+        results = [
+            tkaldi.feats.compute_kaldi_pitch_async(
+                wave, sample_rate, pool, min_f0=60)
+            for wave in waves
+        ]
+        for wave, result in zip(waves, results):
+            expected = tkaldi.feats.compute_kaldi_pitch(
+                wave, sample_rate, min_f0=60)
+            self.assertEqual(expected, torch.jit.wait(result))
+            self.assertTrue(result.done())
+
+    def test_resample_waveform_async(self):
+        """resample_waveform_async returns the same result as the sync op"""
+        wave = utils.data.get_sinusoid(
+            sample_rate=16000, frequency=300,
+            num_channels=1, dtype='int16')[0].to(dtype=torch.float)
+        pool = tkaldi.feats.async_pool()
+        result = tkaldi.feats.resample_waveform_async(wave, 16000, 8000, pool)
+        expected = torch.ops.tkaldi.ResampleWaveform(wave, 16000, 8000, False)
+        self.assertEqual(expected, result.wait(), rtol=0, atol=0)
+
+    def test_async_non_blocking(self):
+        """With block=False, the async ops raise instead of waiting for a slot"""
+        wave = utils.data.get_sinusoid(
+            sample_rate=16000, frequency=300, duration=30,
+            num_channels=1, dtype='int16')[0].to(dtype=torch.float)
+        pool = tkaldi.feats.async_pool(num_threads=1, max_pending=1)
+        results = []
+        with self.assertRaisesRegex(RuntimeError, 'The async pool is full'):
+            for _ in range(10):
+                results.append(tkaldi.feats.compute_kaldi_pitch_async(
+                    wave, 16000, pool, block=False))
+        expected = tkaldi.feats.compute_kaldi_pitch(wave, 16000)
+        for result in results:
+            self.assertEqual(expected, result.wait())
+
+
+class ProcessPitchTest(utils.case.TestCase):
+    def _get_pitch(self):
+        sample_rate = 16000
+        wave = utils.data.get_sinusoid(
+            sample_rate=sample_rate, frequency=300, duration=5,
+            num_channels=1, dtype='int16')[0].to(dtype=torch.float)
+        return tkaldi.feats.compute_kaldi_pitch(wave, sample_rate)
+
+    @parameterized.expand([
+        ({}, ),
+        ({'delay': 3, 'add_raw_log_pitch': True}, ),
+        ({'normalization_left_context': 10, 'delta_window': 3}, ),
+    ])
+    def test_process_pitch(self, args):
+        """Approximate post-processing matches Kaldi's up to rounding"""
+        # The noise makes the results depend on the random number state.
+        args['delta_pitch_noise_stddev'] = 0.0
+        pitch = self._get_pitch()
+        expected = tkaldi.feats.process_pitch(
+            pitch, method='reference', **args)
+        found = tkaldi.feats.process_pitch(pitch, method='approximate', **args)
+        self.assertEqual(expected, found, rtol=1e-5, atol=1e-5)
+
+    def test_process_pitch_unknown_method(self):
+        """An unknown method is a RuntimeError listing the accepted ones"""
+        with self.assertRaisesRegex(RuntimeError, "'reference' or 'approximate'"):
+            tkaldi.feats.process_pitch(self._get_pitch(), method='sliding')
+
+
+class ArbitraryResampleTest(utils.case.TestCase):
+    @parameterized.expand([
+        ('banded', 0),
+        ('fused', 1e-6),
+        ('matmul', 1e-6),
+    ])
+    def test_arbitrary_resample(self, method, tolerance):
+        """BandedResample matches ArbitraryResample::Resample"""
+        # The NCCF upsampling of the pitch extractor with default options
+        resample_frequency, min_f0, max_f0, delta_pitch = 4000, 50, 400, 0.005
+        lags = [1 / max_f0]
+        while lags[-1] * (1 + delta_pitch) <= 1 / min_f0:
+            lags.append(lags[-1] * (1 + delta_pitch))
+        first_lag = int(resample_frequency / max_f0) - 5
+        last_lag = int(resample_frequency / min_f0) + 5
+        sample_points = torch.tensor(lags) - first_lag / resample_frequency
+        nccf = torch.rand(100, last_lag + 1 - first_lag) * 2 - 1
+
+        args = (resample_frequency, resample_frequency / 2,
+                sample_points.to(torch.float), 5)
+        expected = torch.ops.tkaldi.ArbitraryResample(nccf, *args, 'reference')
+        found = torch.ops.tkaldi.ArbitraryResample(nccf, *args, method)
+        self.assertEqual(expected, found, rtol=tolerance, atol=tolerance)
+
+    @parameterized.expand([
+        (torch.float16, ),
+        (torch.bfloat16, ),
+    ])
+    def test_arbitrary_resample_reduced_precision(self, dtype):
+        """Fused resampling of reduced precision input widens it as it reads"""
+        sample_points = torch.linspace(0.0, 0.02, 150)
+        nccf = (torch.rand(100, 91) * 2 - 1).to(dtype)
+        args = (4000., 2000., sample_points, 5, 'fused')
+        expected = torch.ops.tkaldi.ArbitraryResample(
+            nccf.to(torch.float), *args)
+        found = torch.ops.tkaldi.ArbitraryResample(nccf, *args)
+        self.assertEqual(expected, found, rtol=1e-5, atol=1e-5)
+
+    def test_arbitrary_resample_unknown_method(self):
+        """ArbitraryResample rejects an unknown method"""
+        sample_points = torch.linspace(0.0, 0.02, 150)
+        nccf = torch.rand(10, 91)
+        with self.assertRaisesRegex(RuntimeError, 'Unknown method: foo'):
+            torch.ops.tkaldi.ArbitraryResample(
+                nccf, 4000., 2000., sample_points, 5, 'foo')
+
+
+class CmvnTest(utils.case.TestCase):
+    def test_compute_cmvn_stats(self):
+        """compute_cmvn_stats matches compute-cmvn-stats"""
+        feats = torch.randn(300, 13) * 5 + 2
+        command = ['compute-cmvn-stats', 'ark:-', 'ark:-']
+        expected = utils.kaldi.run_command_ark(command, feats)
+        found = tkaldi.feats.compute_cmvn_stats([feats])[0]
+        self.assertEqual(expected, found, rtol=0, atol=0)
+
+    @parameterized.expand([
+        (False, False),
+        (True, False),
+        (False, True),
+        (True, True),
+    ])
+    def test_apply_cmvn(self, norm_vars, reverse):
+        """apply_cmvn matches apply-cmvn"""
+        feats = torch.randn(300, 13) * 5 + 2
+        stats = tkaldi.feats.compute_cmvn_stats([torch.randn(200, 13)])[0]
+        path = self.get_temp_path('cmvn.mat')
+        with open(path, 'wb') as file_:
+            kaldi_io.write_mat(file_, stats.numpy())
+
+        args = utils.kaldi.convert_args(norm_vars=norm_vars, reverse=reverse)
+        command = ['apply-cmvn'] + args + [path, 'ark:-', 'ark:-']
+        expected = utils.kaldi.run_command_ark(command, feats)
+        found = tkaldi.feats.apply_cmvn(
+            [feats.clone()], stats, norm_vars=norm_vars, reverse=reverse)[0]
+        self.assertEqual(expected, found, rtol=0, atol=0)
+
+    @parameterized.expand([
+        (torch.float16, ),
+        (torch.bfloat16, ),
+    ])
+    def test_compute_cmvn_stats_reduced_precision(self, dtype):
+        """compute_cmvn_stats of reduced precision features widens them"""
+        feats = [(torch.randn(n, 13) * 5 + 2).to(dtype) for n in [300, 50]]
+        expected = tkaldi.feats.compute_cmvn_stats(
+            [f.to(torch.float) for f in feats])
+        found = tkaldi.feats.compute_cmvn_stats(feats)
+        self.assertEqual(expected, found, rtol=0, atol=0)
+
+    def test_cmvn_groups(self):
+        """Grouped and threaded CMVN matches processing each group alone"""
+        feats = [torch.randn(100 * (i + 1), 13) + i for i in range(6)]
+        groups = [0, 1, 2, 0, 1, 0]
+        stats = tkaldi.feats.compute_cmvn_stats(
+            feats, groups, num_threads=3)
+        normalized = tkaldi.feats.apply_cmvn(
+            [f.clone() for f in feats], stats, groups, norm_vars=True,
+            num_threads=3)
+        for group in range(3):
+            members = [i for i, g in enumerate(groups) if g == group]
+            expected = tkaldi.feats.compute_cmvn_stats(
+                [feats[i] for i in members])[0]
+            self.assertEqual(expected, stats[group], rtol=0, atol=0)
+            for i in members:
+                self.assertEqual(
+                    tkaldi.feats.apply_cmvn(
+                        [feats[i].clone()], expected, norm_vars=True)[0],
+                    normalized[i], rtol=0, atol=0)
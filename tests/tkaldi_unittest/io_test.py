@@ -0,0 +1,156 @@
+"""Test """
+
+import subprocess
+
+import kaldi_io
+import numpy as np
+import torch
+import tkaldi
+from parameterized import parameterized
+
+from tkaldi_unittest import utils
+
+
+def _get_matrices():
+    torch.manual_seed(0)
+    return {
+        f'utt{i}': torch.randn(num_rows, 13)
+        for i, num_rows in enumerate([300, 1, 0, 57])
+    }
+
+
+class NpyTest(utils.case.TestCase):
+    def test_write_npy(self):
+        """write_npy writes a file numpy.load reads"""
+        matrix = torch.randn(100, 13)
+        path = self.get_temp_path('feats.npy')
+        tkaldi.io.write_npy(path, matrix)
+        self.assertEqual(torch.from_numpy(np.load(path)), matrix,
+                         rtol=0, atol=0)
+
+    @parameterized.expand([
+        (np.float32, ),
+        (np.float64, ),
+    ])
+    def test_read_npy(self, dtype):
+        """read_npy reads a file numpy.save writes"""
+        matrix = np.random.randn(100, 13).astype(dtype)
+        path = self.get_temp_path('feats.npy')
+        np.save(path, matrix)
+        found = tkaldi.io.read_npy(path)
+        self.assertEqual(found, torch.from_numpy(matrix).to(torch.float),
+                         rtol=0, atol=0)
+
+    def test_read_npy_copy_on_write(self):
+        """Modifying a matrix read with read_npy does not change the file"""
+        path = self.get_temp_path('feats.npy')
+        tkaldi.io.write_npy(path, torch.zeros(10, 3))
+        tkaldi.io.read_npy(path).fill_(1)
+        self.assertEqual(tkaldi.io.read_npy(path), torch.zeros(10, 3))
+
+    @parameterized.expand([
+        ('npz', ),
+        ('npy', ),
+    ])
+    def test_npy_archive(self, kind):
+        """npy_archive reads what npy_archive_writer writes"""
+        matrices = _get_matrices()
+        path = self.get_temp_path(f'feats.{kind}')
+        writer = tkaldi.io.npy_archive_writer(f'{kind}:{path}')
+        for key, matrix in matrices.items():
+            writer.write(key, matrix)
+        writer.close()
+
+        archive = tkaldi.io.npy_archive(f'{kind}:{path}')
+        self.assertEqual(archive.keys(), list(matrices))
+        self.assertEqual(archive.size(), len(matrices))
+        self.assertFalse(archive.contains('foo'))
+        for key, matrix in matrices.items():
+            self.assertEqual(archive.get(key), matrix, rtol=0, atol=0)
+
+    def test_npz_numpy(self):
+        """.npz archives are compatible with numpy.savez and numpy.load"""
+        matrices = _get_matrices()
+        path = self.get_temp_path('feats.npz')
+        writer = tkaldi.io.npy_archive_writer(f'npz:{path}')
+        for key, matrix in matrices.items():
+            writer.write(key, matrix)
+        writer.close()
+        with np.load(path) as found:
+            for key, matrix in matrices.items():
+                self.assertEqual(torch.from_numpy(found[key]), matrix,
+                                 rtol=0, atol=0)
+
+        path = self.get_temp_path('numpy.npz')
+        np.savez(path, **{k: v.numpy() for k, v in matrices.items()})
+        archive = tkaldi.io.npy_archive(f'npz:{path}')
+        for key, matrix in matrices.items():
+            self.assertEqual(archive.get(key), matrix, rtol=0, atol=0)
+
+    def test_corpus_numpy(self):
+        """A corpus .npy loads with numpy.load, and its index slices it"""
+        matrices = _get_matrices()
+        path = self.get_temp_path('feats.npy')
+        writer = tkaldi.io.npy_archive_writer(f'npy:{path}')
+        for key, matrix in matrices.items():
+            writer.write(key, matrix)
+        writer.close()
+        corpus = np.load(path, mmap_mode='r')
+        with open(f'{path}.index') as file_:
+            for line in file_:
+                key, first_row, num_rows = line.split()
+                rows = corpus[int(first_row):int(first_row) + int(num_rows)]
+                self.assertEqual(torch.from_numpy(np.array(rows)),
+                                 matrices[key], rtol=0, atol=0)
+
+
+class NpySpecifierTest(utils.case.TestCase):
+    @parameterized.expand([
+        ('npz', ),
+        ('npy', ),
+    ])
+    def test_compute_kaldi_pitch_feats_parallel(self, kind):
+        """compute-kaldi-pitch-feats-parallel writes npz: and npy:"""
+        sample_rate = 16000
+        scp_path = self.get_temp_path('wav.scp')
+        expected = {}
+        with open(scp_path, 'w') as file_:
+            for i, frequency in enumerate([300, 200, 150]):
+                wave = utils.data.get_sinusoid(
+                    sample_rate=sample_rate, frequency=frequency,
+                    num_channels=1, dtype='int16')[0]
+                path = self.get_temp_path(f'{i}.wav')
+                utils.io.save_wav(path, wave, sample_rate)
+                file_.write(f'utt{i} {path}\n')
+                expected[f'utt{i}'] = tkaldi.feats.compute_kaldi_pitch(
+                    wave.to(torch.float), sample_rate)
+
+        path = self.get_temp_path(f'feats.{kind}')
+        subprocess.run([
+            'compute-kaldi-pitch-feats-parallel',
+            f'--sample-frequency={sample_rate}',
+            f'scp:{scp_path}', f'{kind}:{path}'], check=True)
+        archive = tkaldi.io.npy_archive(f'{kind}:{path}')
+        self.assertEqual(archive.keys(), list(expected))
+        for key, feats in expected.items():
+            self.assertEqual(archive.get(key), feats)
+
+    def test_apply_cmvn(self):
+        """apply-cmvn reads and writes npz:"""
+        matrices = _get_matrices()
+        stats = tkaldi.feats.compute_cmvn_stats([torch.randn(200, 13)])[0]
+        stats_path = self.get_temp_path('cmvn.mat')
+        with open(stats_path, 'wb') as file_:
+            kaldi_io.write_mat(file_, stats.numpy())
+        input_path = self.get_temp_path('input.npz')
+        np.savez(input_path, **{k: v.numpy() for k, v in matrices.items()})
+
+        output_path = self.get_temp_path('output.npz')
+        subprocess.run([
+            'apply-cmvn', stats_path, f'npz:{input_path}',
+            f'npz:{output_path}'], check=True)
+        found = tkaldi.io.npy_archive(f'npz:{output_path}')
+        expected = tkaldi.feats.apply_cmvn(
+            [m.clone() for m in matrices.values()], stats)
+        for key, feats in zip(matrices, expected):
+            self.assertEqual(found.get(key), feats, rtol=0, atol=0)
@@ -0,0 +1,135 @@
+"""Test the storage management of the Vector / Matrix shim"""
+
+import torch
+from parameterized import parameterized
+
+from tkaldi_unittest import utils
+
+
+def _num_reallocations():
+    return torch.ops.tkaldi.NumReallocations()
+
+
+class VectorTest(utils.case.TestCase):
+    @parameterized.expand([
+        ('set_zero', ),
+        ('undefined', ),
+        ('copy_data', ),
+    ])
+    def test_resize_within_capacity(self, resize_type):
+        """Resize does not reallocate as long as the storage is large enough"""
+        vector = torch.classes.tkaldi.Vector(torch.randn(100))
+        vector.resize(10, resize_type)
+        self.assertEqual(_num_reallocations(), 0)
+        vector.resize(100, resize_type)
+        self.assertEqual(_num_reallocations(), 0)
+        vector.resize(101, resize_type)
+        self.assertEqual(_num_reallocations(), 1)
+
+    def test_reserve(self):
+        """Resize up to the reserved capacity does not reallocate"""
+        data = torch.randn(10)
+        vector = torch.classes.tkaldi.Vector(data)
+        vector.reserve(1000)
+        self.assertEqual(_num_reallocations(), 1)
+        self.assertEqual(vector.data(), data, rtol=0, atol=0)
+        vector.resize(1000, 'copy_data')
+        self.assertEqual(_num_reallocations(), 0)
+        self.assertEqual(vector.data()[:10], data, rtol=0, atol=0)
+
+    def test_resize_copy_data(self):
+        """kCopyData keeps the data and zeroes the new elements"""
+        data = torch.randn(10)
+        vector = torch.classes.tkaldi.Vector(data)
+        vector.resize(6, 'copy_data')
+        self.assertEqual(vector.data(), data[:6], rtol=0, atol=0)
+        # Within capacity: the elements dropped above must not reappear.
+        vector.resize(10, 'copy_data')
+        self.assertEqual(vector.data()[:6], data[:6], rtol=0, atol=0)
+        self.assertEqual(vector.data()[6:], torch.zeros(4), rtol=0, atol=0)
+        # Beyond capacity.
+        vector.resize(20, 'copy_data')
+        self.assertEqual(_num_reallocations(), 1)
+        self.assertEqual(vector.data()[:6], data[:6], rtol=0, atol=0)
+        self.assertEqual(vector.data()[6:], torch.zeros(14), rtol=0, atol=0)
+
+    def test_copy(self):
+        """The copy constructor does not alias its source"""
+        data = torch.randn(10)
+        expected = data.clone()
+        vector = torch.classes.tkaldi.Vector(data)
+        vector.data().fill_(0)
+        self.assertEqual(data, expected, rtol=0, atol=0)
+
+
+class MatrixTest(utils.case.TestCase):
+    @parameterized.expand([
+        ('set_zero', ),
+        ('undefined', ),
+        ('copy_data', ),
+    ])
+    def test_resize_within_capacity(self, resize_type):
+        """Resize does not reallocate as long as the storage is large enough"""
+        matrix = torch.classes.tkaldi.Matrix(torch.randn(10, 4), False)
+        matrix.resize(5, 4, resize_type)
+        self.assertEqual(_num_reallocations(), 0)
+        matrix.resize(10, 4, resize_type)
+        self.assertEqual(_num_reallocations(), 0)
+        matrix.resize(11, 4, resize_type)
+        self.assertEqual(_num_reallocations(), 1)
+
+    def test_reserve(self):
+        """Resize up to the reserved capacity does not reallocate"""
+        data = torch.randn(10, 4)
+        matrix = torch.classes.tkaldi.Matrix(data, False)
+        matrix.reserve(100, 4)
+        self.assertEqual(_num_reallocations(), 1)
+        self.assertEqual(matrix.data(), data, rtol=0, atol=0)
+        matrix.resize(100, 4, 'copy_data')
+        self.assertEqual(_num_reallocations(), 0)
+        self.assertEqual(matrix.data()[:10], data, rtol=0, atol=0)
+
+    def test_resize_copy_data_rows(self):
+        """kCopyData keeps the rows and zeroes the new ones"""
+        data = torch.randn(10, 4)
+        matrix = torch.classes.tkaldi.Matrix(data, False)
+        matrix.resize(6, 4, 'copy_data')
+        self.assertEqual(matrix.data(), data[:6], rtol=0, atol=0)
+        # Within capacity: the rows dropped above must not reappear.
+        matrix.resize(10, 4, 'copy_data')
+        self.assertEqual(matrix.data()[:6], data[:6], rtol=0, atol=0)
+        self.assertEqual(matrix.data()[6:], torch.zeros(4, 4), rtol=0, atol=0)
+        # Beyond capacity.
+        matrix.resize(20, 4, 'copy_data')
+        self.assertEqual(_num_reallocations(), 1)
+        self.assertEqual(matrix.data()[:6], data[:6], rtol=0, atol=0)
+        self.assertEqual(matrix.data()[6:], torch.zeros(14, 4), rtol=0, atol=0)
+
+    def test_resize_copy_data_cols(self):
+        """kCopyData keeps the top-left block when the columns change"""
+        data = torch.randn(10, 4)
+        matrix = torch.classes.tkaldi.Matrix(data, False)
+        matrix.resize(8, 3, 'copy_data')
+        self.assertEqual(matrix.data(), data[:8, :3], rtol=0, atol=0)
+        matrix.resize(12, 5, 'copy_data')
+        expected = torch.zeros(12, 5)
+        expected[:8, :3] = data[:8, :3]
+        self.assertEqual(matrix.data(), expected, rtol=0, atol=0)
+
+    @parameterized.expand([
+        (torch.float32, False),
+        (torch.float32, True),
+        (torch.float64, False),
+        (torch.float64, True),
+    ])
+    def test_copy(self, dtype, transpose):
+        """The copy constructors make a contiguous copy of their source"""
+        data = torch.randn(10, 4, dtype=dtype)
+        expected = data.clone()
+        matrix = torch.classes.tkaldi.Matrix(data, transpose)
+        self.assertEqual(matrix.data().dtype, torch.float32)
+        self.assertTrue(matrix.data().is_contiguous())
+        self.assertEqual(matrix.data(), (data.t() if transpose else data).float(),
+                         rtol=0, atol=0)
+        matrix.data().fill_(0)
+        self.assertEqual(data, expected, rtol=0, atol=0)